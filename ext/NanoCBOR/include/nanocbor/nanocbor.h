@@ -214,6 +214,19 @@ bool nanocbor_at_end(const nanocbor_value_t *it);
  */
 int nanocbor_get_uint32(nanocbor_value_t *cvalue, uint32_t *value);
 
+/**
+ * @brief Retrieve a positive integer as uint64_t from the stream
+ *
+ * The resulting @p value is undefined if the result is an error condition
+ *
+ * @param[in]   cvalue  CBOR value to decode from
+ * @param[out]  value   returned positive integer
+ *
+ * @return              number of bytes read
+ * @return              negative on error
+ */
+int nanocbor_get_uint64(nanocbor_value_t *cvalue, uint64_t *value);
+
 /**
  * @brief Retrieve a signed integer as int32_t from the stream
  *
@@ -294,6 +307,9 @@ void nanocbor_leave_container(nanocbor_value_t *it, nanocbor_value_t *container)
 /**
  * @brief Retrieve a tag as positive uint32_t from the stream
  *
+ * The tag is not counted as an item of the enclosing container, as it only
+ * qualifies the item that follows it.
+ *
  * The resulting @p value is undefined if the result is an error condition
  *
  * @param[in]   cvalue  CBOR value to decode from
@@ -150,6 +150,16 @@ int nanocbor_get_uint32(nanocbor_value_t *cvalue, uint32_t *value)
     return _get_and_advance_uint32(cvalue, value, NANOCBOR_TYPE_UINT);
 }
 
+int nanocbor_get_uint64(nanocbor_value_t *cvalue, uint64_t *value)
+{
+    uint64_t tmp = 0;
+    int res = _get_uint64(cvalue, (uint32_t*)&tmp, NANOCBOR_SIZE_LONG,
+                          NANOCBOR_TYPE_UINT);
+    *value = tmp;
+
+    return _advance_if(cvalue, res);
+}
+
 int nanocbor_get_int32(nanocbor_value_t *cvalue, int32_t *value)
 {
     int type = nanocbor_get_type(cvalue);
@@ -176,7 +186,17 @@ int nanocbor_get_int32(nanocbor_value_t *cvalue, int32_t *value)
 
 int nanocbor_get_tag(nanocbor_value_t *cvalue, uint32_t *tag)
 {
-    return _get_and_advance_uint32(cvalue, tag, NANOCBOR_TYPE_TAG);
+    /* A tag only qualifies the item that follows it, it is not an item of
+     * the enclosing container, so the remaining count is left as is. */
+    uint32_t tmp = 0;
+    int res = _get_uint64(cvalue, &tmp, NANOCBOR_SIZE_WORD,
+                          NANOCBOR_TYPE_TAG);
+    *tag = tmp;
+
+    if (res > 0) {
+        cvalue->cur += res;
+    }
+    return res;
 }
 
 static int _get_str(nanocbor_value_t *cvalue, const uint8_t **buf, size_t *len, uint8_t type)
@@ -322,6 +342,14 @@ int _skip_limited(nanocbor_value_t *it, uint8_t limit)
             nanocbor_leave_container(it, &recurse);
         }
     }
+    /* a tag and the item it qualifies */
+    else if (type == NANOCBOR_TYPE_TAG) {
+        uint32_t tag;
+        res = nanocbor_get_tag(it, &tag);
+        if (res > 0) {
+            res = _skip_limited(it, limit - 1);
+        }
+    }
     else if (type >= 0) {
         res = _skip_simple(it);
     }
@@ -47,6 +47,67 @@ static void test_decode_basic(void)
     CU_ASSERT_EQUAL(5, intval);
 }
 
+static void test_decode_uint64(void)
+{
+    nanocbor_value_t decoder;
+    /* unsigned integer, value 12345678901 */
+    const uint8_t long_val[] = { 0x1b, 0x00, 0x00, 0x00, 0x02, 0xdf, 0xdc, 0x1c, 0x35 };
+    /* unsigned integer, value 500 */
+    const uint8_t short_val[] = { 0x19, 0x01, 0xf4 };
+    uint64_t value = 0;
+    uint32_t value32 = 0;
+
+    nanocbor_decoder_init(&decoder, long_val, sizeof(long_val));
+    CU_ASSERT_EQUAL(nanocbor_get_uint64(&decoder, &value), 9);
+    CU_ASSERT_EQUAL(value, 12345678901ULL);
+    CU_ASSERT(nanocbor_at_end(&decoder));
+
+    nanocbor_decoder_init(&decoder, long_val, sizeof(long_val));
+    CU_ASSERT_EQUAL(nanocbor_get_uint32(&decoder, &value32), NANOCBOR_ERR_OVERFLOW);
+
+    nanocbor_decoder_init(&decoder, short_val, sizeof(short_val));
+    CU_ASSERT_EQUAL(nanocbor_get_uint64(&decoder, &value), 3);
+    CU_ASSERT_EQUAL(value, 500);
+
+    /* Truncated value */
+    nanocbor_decoder_init(&decoder, long_val, sizeof(long_val) - 1);
+    CU_ASSERT(nanocbor_get_uint64(&decoder, &value) < 0);
+}
+
+static void test_decode_tag(void)
+{
+    nanocbor_value_t decoder;
+    nanocbor_value_t cont;
+    /* [1(2), 3] */
+    const uint8_t arr[] = { 0x82, 0xc1, 0x02, 0x03 };
+    /* {1: 1(2), 3: 4} */
+    const uint8_t map[] = { 0xa2, 0x01, 0xc1, 0x02, 0x03, 0x04 };
+    uint32_t value = 0;
+
+    /* The tag is not an item of the array */
+    nanocbor_decoder_init(&decoder, arr, sizeof(arr));
+    CU_ASSERT(nanocbor_enter_array(&decoder, &cont) > 0);
+    CU_ASSERT_EQUAL(nanocbor_get_tag(&cont, &value), 1);
+    CU_ASSERT_EQUAL(value, 1);
+    CU_ASSERT_EQUAL(nanocbor_get_uint32(&cont, &value), 1);
+    CU_ASSERT_EQUAL(value, 2);
+    CU_ASSERT(!nanocbor_at_end(&cont));
+    CU_ASSERT_EQUAL(nanocbor_get_uint32(&cont, &value), 1);
+    CU_ASSERT_EQUAL(value, 3);
+    CU_ASSERT(nanocbor_at_end(&cont));
+
+    /* Skipping a tagged value skips the item it qualifies too */
+    nanocbor_decoder_init(&decoder, map, sizeof(map));
+    CU_ASSERT(nanocbor_enter_map(&decoder, &cont) > 0);
+    CU_ASSERT_EQUAL(nanocbor_get_uint32(&cont, &value), 1);
+    CU_ASSERT(nanocbor_skip(&cont) >= 0);
+    CU_ASSERT_EQUAL(nanocbor_get_uint32(&cont, &value), 1);
+    CU_ASSERT_EQUAL(value, 3);
+    CU_ASSERT_EQUAL(nanocbor_get_uint32(&cont, &value), 1);
+    CU_ASSERT_EQUAL(value, 4);
+    CU_ASSERT(nanocbor_at_end(&cont));
+}
+
 const test_t tests_decoder[] = {
     {
         .f = test_decode_none,
@@ -56,6 +117,14 @@ const test_t tests_decoder[] = {
         .f = test_decode_basic,
         .n = "Simple CBOR integer tests",
     },
+    {
+        .f = test_decode_uint64,
+        .n = "64 bit CBOR integer tests",
+    },
+    {
+        .f = test_decode_tag,
+        .n = "CBOR tag tests",
+    },
     {
         .f = NULL,
         .n = NULL,
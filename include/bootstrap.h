@@ -7,6 +7,8 @@
 #ifndef __BOOTSTRAP_H__
 #define __BOOTSTRAP_H__
 
+#include "key_mgmt.h"
+
 /**
  * @brief The context for bootstrap REST requests.
  */
@@ -52,6 +54,29 @@ struct csr_req {
  */
 int bootstrap_csr(struct bootstrap *ctx, struct csr_req *req, uint8_t key_idx);
 
+/**
+ * @brief The context needed for the batch CSR request.
+ *
+ * All fields are private.  The struct is exposed because the caller
+ * is responsible for the allocation of this data.
+ */
+struct csr_batch_req {
+	uint8_t uuid[37];
+	uint8_t cbor[KEY_COUNT * 1024];
+	size_t cbor_len;
+};
+
+/**
+ * @brief Perform a CSR request for every key in one request
+ *
+ * The CSRs are sent as one CBOR array, and the server answers with an
+ * array of the certificates in the same order.  The certificates are
+ * decoded and stored as they arrive.
+ *
+ * @return 0 for success, or a negative errno
+ */
+int bootstrap_csr_all(struct bootstrap *ctx, struct csr_batch_req *req);
+
 /**
  * @brief Request service configuration
  *
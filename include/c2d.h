@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef C2D_H
+#define C2D_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Cloud-to-device inference commands.
+ *
+ * A command is a CBOR map, with its keys in this order:
+ *
+ *   1: job ID (uint), echoed in every reply
+ *   2: model (uint, infer_model_idx_t)
+ *   3: output encoding (uint, infer_enc_t)
+ *   4: inputs (bstr, packed little-endian float32 values)
+ *
+ * Commands are decoded while they are read, and an inference request is
+ * queued for every input as soon as its bytes arrive. Each result is sent
+ * back as the CBOR array [job ID, input, output], where output is the
+ * encoded inference output, or the PSA status if the inference failed.
+ * Inputs are never waited on: an input that finds the inference queue full
+ * is dropped, and replied to right away with PSA_ERROR_INSUFFICIENT_MEMORY.
+ */
+
+/**
+ * @brief Send a reply to a command.
+ *
+ * Called from the inference worker threads, and from the thread decoding
+ * the command for dropped inputs.
+ *
+ * @param buf  CBOR encoded reply.
+ * @param len  Size of the reply in bytes.
+ */
+typedef void (*c2d_reply_cb_t)(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Register for the results of the queued commands.
+ *
+ * @param reply  Callback sending each reply to the cloud.
+ */
+void c2d_init(c2d_reply_cb_t reply);
+
+/**
+ * @brief Start decoding a new command.
+ */
+void c2d_begin(void);
+
+/**
+ * @brief Decode the next chunk of the command.
+ *
+ * @param buf  Chunk of the command payload.
+ * @param len  Size of the chunk in bytes.
+ */
+void c2d_feed(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Finish decoding the command.
+ *
+ * @return 0 on success, -EINVAL if the command was malformed or truncated.
+ * Inputs queued before the error still produce replies.
+ */
+int c2d_end(void);
+
+#endif /* C2D_H */
@@ -19,6 +19,68 @@
 #define COSE_ERROR_DECODE               0x02
 #define COSE_ERROR_AUTHENTICATE         0x03
 #define COSE_ERROR_HASH                 0x04
+#define COSE_ERROR_KEY                  0x05
+
+/* EAT claim labels of the inference payload, as encoded by the secure side */
+#define EAT_CBOR_LINARO_RANGE_BASE                     (-80000)
+#define EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE          (EAT_CBOR_LINARO_RANGE_BASE - 0)
+#define EAT_CBOR_LINARO_NV_COUNTER_ROLL_OVER           (EAT_CBOR_LINARO_RANGE_BASE - 5)
+#define EAT_CBOR_LINARO_NV_COUNTER_VALUE               (EAT_CBOR_LINARO_RANGE_BASE - 6)
+#define EAT_CBOR_LINARO_LABEL_MODEL_ID                 (EAT_CBOR_LINARO_RANGE_BASE - 7)
+#define EAT_CBOR_LINARO_LABEL_TIMESTAMP                (EAT_CBOR_LINARO_RANGE_BASE - 8)
+#define EAT_CBOR_LINARO_LABEL_INFERENCE_TENSOR         (EAT_CBOR_LINARO_RANGE_BASE - 9)
+#define EAT_CBOR_LINARO_LABEL_QUANT_PARAMS             (EAT_CBOR_LINARO_RANGE_BASE - 10)
+
+/* RFC 8746 tags used for output tensors */
+#define COSE_CBOR_TAG_MULTI_DIM_ARRAY                  40
+#define COSE_CBOR_TAG_TA_SINT8                         72
+#define COSE_CBOR_TAG_TA_SINT16_LE                     77
+#define COSE_CBOR_TAG_TA_FLOAT32_LE                    85
+
+/** Maximum number of dimensions of an output tensor. */
+#define COSE_TENSOR_MAX_DIMS                           4
+
+/** Element type of the inference output. */
+typedef enum {
+	COSE_TENSOR_NONE = 0,           /**< A single float value. */
+	COSE_TENSOR_FLOAT32,            /**< float32 tensor. */
+	COSE_TENSOR_INT8,               /**< Quantized int8 tensor. */
+	COSE_TENSOR_INT16,              /**< Quantized int16 tensor. */
+} cose_tensor_type_t;
+
+/** Claims decoded from an inference payload. */
+typedef struct {
+	/** Inference value or tensor data, points into the payload. */
+	const uint8_t *value;
+	/** Size of @p value in bytes. */
+	size_t len_value;
+	/** Element type of @p value. */
+	cose_tensor_type_t tensor_type;
+	/** Tensor shape, unused for COSE_TENSOR_NONE. */
+	uint32_t dims[COSE_TENSOR_MAX_DIMS];
+	/** Number of entries in @p dims. */
+	size_t dims_len;
+	/** Quantization scale of integer tensors. */
+	float scale;
+	/** Quantization zero point of integer tensors. */
+	int32_t zero_point;
+	/** Set if scale and zero_point were present. */
+	bool has_quant;
+	/** Model ID, not NUL-terminated, points into the payload. */
+	const uint8_t *model_id;
+	/** Size of @p model_id in bytes. */
+	size_t len_model_id;
+	/** NV counter value. */
+	uint32_t nv_counter;
+	/** NV counter rollover count. */
+	uint32_t nv_rollover;
+	/** Time the inference was run. */
+	uint64_t timestamp;
+	/** Set if nv_counter and nv_rollover were present. */
+	bool has_nv_counter;
+	/** Set if timestamp was present. */
+	bool has_timestamp;
+} cose_infer_payload_t;
 
 #if CONFIG_NONSECURE_COSE_VERIFY_SIGN
 #ifndef CONFIG_MBEDTLS_CFG_FILE
@@ -34,6 +96,8 @@
 #include <mbedtls/ecdsa.h>
 #include <mbedtls/error.h>
 
+#include "cose/mbedtls_ecdsa_verify_sign.h"
+
 #define COSE_ALG_ECDSA_SHA256 -7
 #define COSE_CONTEXT_SIGN1 "Signature1"
 
@@ -66,6 +130,11 @@ typedef struct {
 	size_t len_sig;
 	size_t len_hash;
 	mbedtls_pk_context pk;
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+	/* Tables precomputed for pk, valid if has_precomp is set */
+	bool has_precomp;
+	mbedtls_ecdsa_precomp_context precomp;
+#endif
 } cose_sign_context_t;
 
 /**
@@ -80,6 +149,17 @@ typedef struct {
  */
 int cose_sign_init(cose_sign_context_t *ctx);
 
+/**
+ * @brief Build the hash state shared by every SIGN1 verification
+ *
+ * Must be called once, before any verification and before the threads that
+ * verify are started.
+ *
+ * @return COSE_ERROR_NONE              Success
+ *         COSE_ERROR_HASH              Failed to set up the hash context
+ */
+int cose_verify_init(void);
+
 /**
  * @brief Decode a COSE object and verify the signature
  *
@@ -100,6 +180,28 @@ int cose_verify_sign1(cose_sign_context_t *ctx,
 		      const uint8_t **pld,
 		      size_t *len_pld);
 
+/**
+ * @brief Verify the signatures of a batch of COSE objects signed by one key
+ *
+ * The hash context setup is done once for the whole batch. Every object is
+ * checked on its own, so a bad signature is reported against its own entry
+ * in @p results.
+ *
+ * @param       ctx     Pointer to the COSE signing context
+ * @param       objs    Encoded COSE objects
+ * @param       lens    Length of each encoded COSE object
+ * @param       n       Number of objects in the batch
+ * @param[out]  results Per-object status, same codes as cose_verify_sign1()
+ *
+ * @return COSE_ERROR_NONE if every object verified, otherwise the status of
+ *         the first object that failed.
+ */
+int cose_verify_sign1_batch(cose_sign_context_t *ctx,
+			    const uint8_t *const objs[],
+			    const size_t lens[],
+			    size_t n,
+			    int results[]);
+
 /**
  * @brief Free underlying MbedTLS contexts
  *
@@ -107,6 +209,41 @@ int cose_verify_sign1(cose_sign_context_t *ctx,
  */
 void cose_sign_free(cose_sign_context_t *ctx);
 
+/**
+ * @brief Get a verification context for the specified key.
+ *
+ * The public key is exported and parsed only the first time, or when the key
+ * has changed since it was cached, so that verifying a stream of SIGN1
+ * payloads costs only the hash and the ECDSA verification. The context is
+ * owned by the cache and must not be freed by the caller.
+ *
+ * On success the cache stays locked, so that the context can't be reloaded
+ * by another thread while it is in use. Every successful call must be
+ * followed by cose_verify_ctx_put() once the caller is done with the context.
+ *
+ * @param       key_idx Key context index.
+ * @param[out]  ctx     Pointer to the cached verification context.
+ *
+ * @return COSE_ERROR_NONE              Success
+ *         COSE_ERROR_KEY               Failed to get or load the public key
+ *         COSE_ERROR_UNSUPPORTED       Crypto algorithm not supported
+ */
+int cose_verify_ctx_get(enum km_key_idx key_idx, cose_sign_context_t **ctx);
+
+/**
+ * @brief Release a verification context got from cose_verify_ctx_get().
+ *
+ * @param ctx Cached verification context, which must not be used afterwards.
+ */
+void cose_verify_ctx_put(cose_sign_context_t *ctx);
+
+/**
+ * @brief Drop the cached verification context of the specified key.
+ *
+ * @param key_idx Key context index.
+ */
+void cose_verify_ctx_invalidate(enum km_key_idx key_idx);
+
 #endif /* CONFIG_NONSECURE_COSE_VERIFY_SIGN */
 
 /**
@@ -146,4 +283,48 @@ int cose_payload_decode(const uint8_t *obj,
 			const size_t len_obj,
 			float *inf_sig_value);
 
+/**
+ * @brief Decode all known claims of an inference payload in a single pass
+ *
+ * The map is walked once, unknown labels are skipped. Strings and the
+ * inference value are returned by pointer into @p obj, which must therefore
+ * outlive @p out.
+ *
+ * @param       obj     Pointer to the CBOR encoded payload map
+ * @param       len_obj Length of the encoded payload
+ * @param[out]  out     Decoded claims
+ *
+ * @return COSE_ERROR_NONE     Success
+ *         COSE_ERROR_DECODE   Malformed payload, or no inference value
+ */
+int cose_payload_decode_claims(const uint8_t *obj,
+			       const size_t len_obj,
+			       cose_infer_payload_t *out);
+
+/**
+ * @brief Get the number of elements of the inference value
+ *
+ * @param       pld     Decoded payload claims
+ *
+ * @return Number of elements, 1 for a single float value.
+ */
+size_t cose_payload_get_count(const cose_infer_payload_t *pld);
+
+/**
+ * @brief Read one float element of the inference value
+ *
+ * Elements of quantized tensors are dequantized with the scale and zero point
+ * of the payload, when present.
+ *
+ * @param       pld     Decoded payload claims
+ * @param       idx     Element index, in row-major order
+ * @param[out]  value   Element value
+ *
+ * @return COSE_ERROR_NONE     Success
+ *         COSE_ERROR_DECODE   @p idx is out of bounds
+ */
+int cose_payload_get_float(const cose_infer_payload_t *pld,
+			   size_t idx,
+			   float *value);
+
 #endif /* COSE_VERIFY_H */
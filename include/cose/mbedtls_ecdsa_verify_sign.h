@@ -47,4 +47,56 @@ int mbedtls_ecdsa_verify_sign(mbedtls_pk_context ctx,
 			      const unsigned char *sig,
 			      size_t sig_len);
 
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+/**
+ * @brief Verification state precomputed for a single public key.
+ *
+ * @p grp is the standard curve group, whose fixed-base table for G is
+ * built once by mbedTLS. @p grp_q is a copy of the same curve with the
+ * public key Q installed as base point, so the comb table for Q is also
+ * built only once and kept for the lifetime of the context.
+ */
+typedef struct {
+	mbedtls_ecp_group grp;
+	mbedtls_ecp_group grp_q;
+} mbedtls_ecdsa_precomp_context;
+
+/**
+ * @brief           Precompute the verification tables for a public key.
+ *
+ * @param ctx       Pointer to the uninitialized precomputation context.
+ * @param pk        The PK context holding the loaded EC public key.
+ *
+ * @return Returns error code as specified in @ref MbedTLS error code.
+ */
+int mbedtls_ecdsa_precomp_init(mbedtls_ecdsa_precomp_context *ctx,
+			       const mbedtls_pk_context *pk);
+
+/**
+ * @brief           Verify signature in non-ASN container format using the
+ *                  precomputed tables of @p ctx.
+ *
+ * @param ctx       Context set up by mbedtls_ecdsa_precomp_init().
+ * @param hash      Hash of the signed message
+ * @param hash_len  Hash length
+ * @param sig       Signature to verify (r || s)
+ * @param sig_len   Signature length
+ *
+ * @return          0 on success (signature is valid),
+ *                  #MBEDTLS_ERR_ECP_VERIFY_FAILED or a specific error code.
+ */
+int mbedtls_ecdsa_precomp_verify(mbedtls_ecdsa_precomp_context *ctx,
+				 const unsigned char *hash,
+				 size_t hash_len,
+				 const unsigned char *sig,
+				 size_t sig_len);
+
+/**
+ * @brief           Release the tables held by @p ctx.
+ *
+ * @param ctx       Context set up by mbedtls_ecdsa_precomp_init().
+ */
+void mbedtls_ecdsa_precomp_free(mbedtls_ecdsa_precomp_context *ctx);
+#endif /* CONFIG_NONSECURE_COSE_VERIFY_PRECOMP */
+
 #endif /* MBEDTLS_ECDSA_VERIFY_SIGN_H */
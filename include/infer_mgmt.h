@@ -14,6 +14,12 @@
 /* Inference encoded buffer maximum supported size */
 #define INFER_ENC_MAX_VALUE_SZ (256)
 
+/* Number of secure input slots available for input tensor uploads */
+#define INFER_INPUT_SLOTS (2)
+
+/* Float values sent per secure call when uploading an input tensor */
+#define INFER_INPUT_CHUNK_SZ (64)
+
 /** Define the index for the model in the model context array. */
 typedef enum {
 	INFER_MODEL_TFLM_SINE = 0,              /**< TFLM sine inference model */
@@ -43,10 +49,18 @@ typedef enum {
 	INFER_ENC_NONE,
 } infer_enc_t;
 
+/** Representation requested for the inference output. */
+typedef enum {
+	INFER_OUT_FLOAT = 0,            /**< Dequantized float values. */
+	INFER_OUT_INT8,                 /**< Raw int8 tensor and quantization. */
+	INFER_OUT_NONE,
+} infer_out_t;
+
 /* Inference config */
 typedef struct {
 	infer_enc_t enc_format;
 	char models[32];
+	infer_out_t out_format;
 } infer_config_t;
 
 #if CONFIG_NONSECURE_COSE_VERIFY_SIGN
@@ -54,19 +68,39 @@ typedef struct {
  * @brief  Verifies the COSE SIGN1 signature of the supplied payload and gets
  * inference value
  *
+ * The public key of the signing key is loaded once and cached, see
+ * cose_verify_ctx_get().
+ *
  * @param infval_enc_buf     Buffer containing the COSE SIGN1 packet to verify.
  * @param infval_enc_buf_len Size of infval_enc_buf.
- * @param pubkey             The EC pubkey to use to verify the signature.
- * @param pubkey_len         Size of pubkey.
+ * @param key_idx            Key context index of the signing key.
  * @param out_val            Inference value.
  *
  * @return psa_status_t
  */
 psa_status_t infer_verify_signature(uint8_t *infval_enc_buf,
 				    size_t infval_enc_buf_len,
-				    uint8_t *pubkey,
-				    size_t pubkey_len,
+				    enum km_key_idx key_idx,
 				    float *out_val);
+
+/**
+ * @brief  Verifies the COSE SIGN1 signatures of a batch of payloads signed by
+ * the same key, see cose_verify_sign1_batch().
+ *
+ * @param infval_enc_bufs    COSE SIGN1 packets to verify.
+ * @param infval_enc_lens    Size of each packet.
+ * @param count              Number of packets.
+ * @param key_idx            Key context index of the signing key.
+ * @param results            Per-packet COSE_ERROR_* status.
+ *
+ * @return COSE_ERROR_NONE if every packet verified, otherwise the status of
+ * the first packet that failed.
+ */
+int infer_verify_signature_batch(const uint8_t *const infval_enc_bufs[],
+				 const size_t infval_enc_lens[],
+				 size_t count,
+				 enum km_key_idx key_idx,
+				 int results[]);
 #endif
 
 /**
@@ -90,6 +124,7 @@ psa_status_t infer_get_value(infer_enc_t enc_fmt,
  * @brief Requests the TFLM inference engine to generate an output value.
  *
  * @param enc_format           Inference output encoding format.
+ * @param out_format           Inference output representation.
  * @param model                Pointer to the buffer stores model info.
  * @param input                The input parameter.
  * @param input_size           The input parameter size in bytes.
@@ -100,6 +135,7 @@ psa_status_t infer_get_value(infer_enc_t enc_fmt,
  * @return psa_status_t
  */
 psa_status_t infer_get_tflm_cose_output(infer_enc_t enc_format,
+					infer_out_t out_format,
 					const char *model,
 					void  *input,
 					size_t input_size,
@@ -107,10 +143,109 @@ psa_status_t infer_get_tflm_cose_output(infer_enc_t enc_format,
 					size_t inf_val_enc_buf_size,
 					size_t *infval_enc_buf_len);
 
+/**
+ * @brief Requests the TFLM inference engine to initialise a model ahead of
+ * its first inference request.
+ *
+ * @param model                Null-terminated model name.
+ *
+ * @return psa_status_t
+ */
+psa_status_t infer_tflm_warmup(const char *model);
+
+/**
+ * @brief Uploads a full input tensor into a secure input slot of the TFLM
+ * inference engine, INFER_INPUT_CHUNK_SZ values per secure call.
+ *
+ * With INFER_INPUT_SLOTS slots, the next frame can be uploaded into one slot
+ * while inference is pending on the other one, see
+ * infer_get_tflm_cose_output_slot().
+ *
+ * @param model                Null-terminated model name.
+ * @param slot                 Input slot to upload into.
+ * @param input                Float input tensor.
+ * @param count                Number of elements in input.
+ *
+ * @return psa_status_t
+ */
+psa_status_t infer_tflm_input_upload(const char *model,
+				     uint32_t slot,
+				     const float *input,
+				     size_t count);
+
+/**
+ * @brief Requests the TFLM inference engine to generate an output value from
+ * an input tensor uploaded with infer_tflm_input_upload().
+ *
+ * @param enc_format           Inference output encoding format.
+ * @param out_format           Inference output representation.
+ * @param model                Pointer to the buffer stores model info.
+ * @param slot                 Input slot holding the uploaded input.
+ * @param infval_enc_buf       Buffer for the COSE-encoded output.
+ * @param inf_val_enc_buf_size Size of infval_enc_buf.
+ * @param infval_enc_buf_len   Bytes written by the secure function.
+ *
+ * @return psa_status_t
+ */
+psa_status_t infer_get_tflm_cose_output_slot(infer_enc_t enc_format,
+					     infer_out_t out_format,
+					     const char *model,
+					     uint32_t slot,
+					     uint8_t *infval_enc_buf,
+					     size_t inf_val_enc_buf_size,
+					     size_t *infval_enc_buf_len);
+
+/**
+ * @brief Opens a streaming session on a stateful TFLM model, clearing the
+ * state left by any earlier stream.
+ *
+ * @param enc_format           Inference output encoding format.
+ * @param out_format           Inference output representation.
+ * @param model                Null-terminated model name.
+ *
+ * @return psa_status_t
+ */
+psa_status_t infer_tflm_stream_open(infer_enc_t enc_format,
+				    infer_out_t out_format,
+				    const char *model);
+
+/**
+ * @brief Pushes the next samples of the open stream through the model.
+ *
+ * count must be a whole number of input frames. The model only sees the new
+ * frames, the history is carried by its variable tensors, and the output of
+ * the last frame is returned. If the secure workspace was claimed by the UTVM
+ * engine while the history was live in it, the stream is closed and
+ * PSA_ERROR_BAD_STATE is returned, the stream has to be opened again. Any
+ * other failure also closes the stream, as the history may have advanced by
+ * only some of the frames.
+ *
+ * @param samples              Float input frames.
+ * @param count                Number of values in samples.
+ * @param infval_enc_buf       Buffer for the COSE-encoded output.
+ * @param inf_val_enc_buf_size Size of infval_enc_buf.
+ * @param infval_enc_buf_len   Bytes written by the secure function.
+ *
+ * @return psa_status_t
+ */
+psa_status_t infer_tflm_stream_push(const float *samples,
+				    size_t count,
+				    uint8_t *infval_enc_buf,
+				    size_t inf_val_enc_buf_size,
+				    size_t *infval_enc_buf_len);
+
+/**
+ * @brief Closes the open TFLM streaming session.
+ *
+ * @return psa_status_t
+ */
+psa_status_t infer_tflm_stream_close(void);
+
 /**
  * @brief Requests the UTVM inference engine to generate an output value.
  *
  * @param enc_format           Inference output encoding format.
+ * @param out_format           Inference output representation.
  * @param model                Pointer to the buffer stores model info.
  * @param input                The input parameter.
  * @param input_size           The input parameter size in bytes.
@@ -121,6 +256,7 @@ psa_status_t infer_get_tflm_cose_output(infer_enc_t enc_format,
  * @return psa_status_t
  */
 psa_status_t infer_get_utvm_cose_output(infer_enc_t enc_format,
+					infer_out_t out_format,
 					const char *model,
 					void  *input,
 					size_t input_size,
@@ -134,6 +270,7 @@ psa_status_t infer_get_utvm_cose_output(infer_enc_t enc_format,
  * infer command calls.
  *
  * @param enc_format           Inference output encoding format.
+ * @param out_format           Inference output representation.
  * @param model                Pointer to the buffer stores model info.
  * @param input                The input parameter.
  * @param input_size           The input parameter size in bytes.
@@ -144,6 +281,7 @@ psa_status_t infer_get_utvm_cose_output(infer_enc_t enc_format,
  * @return psa_status_t
  */
 typedef psa_status_t (*infer_get_cose_output)(infer_enc_t enc_format,
+					      infer_out_t out_format,
 					      const char *model,
 					      void  *input,
 					      size_t input_size,
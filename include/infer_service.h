@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef INFER_SERVICE_H
+#define INFER_SERVICE_H
+
+#include <zephyr/zephyr.h>
+#include <zephyr/sys/slist.h>
+#include <psa/error.h>
+#include "infer_mgmt.h"
+
+/** Scheduling class of an inference request. */
+typedef enum {
+	INFER_PRIO_INTERACTIVE = 0,     /**< Served first, e.g. shell requests. */
+	INFER_PRIO_BACKGROUND,          /**< Served when no interactive request waits. */
+	INFER_PRIO_COUNT,
+} infer_prio_t;
+
+/** Inference request queued to the inference service. */
+typedef struct {
+	infer_model_idx_t model;        /**< Model to run. */
+	infer_enc_t enc_format;         /**< Inference output encoding format. */
+	infer_out_t out_format;         /**< Inference output representation. */
+	float input;                    /**< Model input value. */
+	infer_prio_t prio;              /**< Scheduling class. */
+	void *tag;                      /**< Requester tag, passed back with the result. */
+	uint8_t *out;                   /**< Buffer to encode into, NULL for a worker buffer. */
+	size_t out_size;                /**< Size of out. */
+} infer_request_t;
+
+/** Result of an inference request. Only valid during the subscriber call. */
+typedef struct {
+	const infer_request_t *req;     /**< Request the result belongs to. */
+	psa_status_t status;            /**< Status of the secure inference call. */
+	const uint8_t *buf;             /**< Encoded inference output. */
+	size_t len;                     /**< Bytes in buf. */
+} infer_result_t;
+
+/**
+ * @brief Result callback, called from the inference worker thread for every
+ * completed request.
+ *
+ * @param res        Result of the request.
+ * @param user_data  User data given at subscription.
+ */
+typedef void (*infer_result_cb_t)(const infer_result_t *res, void *user_data);
+
+/** Result subscriber, see infer_service_subscribe(). */
+struct infer_subscriber {
+	sys_snode_t node;
+	infer_result_cb_t cb;
+	void *user_data;
+};
+
+/**
+ * @brief Start the inference worker threads.
+ *
+ * Requests are served from two bounded queues, interactive requests always
+ * before background ones, by CONFIG_INFER_SERVICE_THREADS workers.
+ */
+void infer_service_init(void);
+
+/**
+ * @brief Queue an inference request.
+ *
+ * @param req      Request to queue, copied into the queue.
+ * @param timeout  Time to wait for room in the queue of req->prio.
+ *
+ * @return 0 on success, -EAGAIN or -ENOMSG if the queue stayed full, or
+ * -EINVAL for an invalid request.
+ */
+int infer_service_submit(const infer_request_t *req, k_timeout_t timeout);
+
+/**
+ * @brief Register a subscriber for the results of every request.
+ *
+ * Subscribers run on the worker thread, must not block for long, and must
+ * copy whatever they need from the result before returning.
+ *
+ * @param sub  Subscriber to register, must stay valid until unsubscribed.
+ */
+void infer_service_subscribe(struct infer_subscriber *sub);
+
+/**
+ * @brief Remove a subscriber registered with infer_service_subscribe().
+ *
+ * @param sub  Subscriber to remove.
+ */
+void infer_service_unsubscribe(struct infer_subscriber *sub);
+
+#endif /* INFER_SERVICE_H */
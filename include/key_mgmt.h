@@ -56,6 +56,9 @@ struct km_key_context {
 	size_t local_private_len;
 	/** PSA Crypto key handle for the key in the secure domain. */
 	psa_key_handle_t key_handle;
+	/** Incremented whenever the key material changes, so that cached
+	 * copies of the public key can be invalidated. */
+	uint32_t generation;
 };
 
 /** X.509 certificate context. */
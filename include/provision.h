@@ -21,18 +21,36 @@ extern "C" {
  */
 #define APP_PS_BASE  0x3e28e8993c690000
 
-/** Device certificate.  Returned from CA server.
+/** Device certificate.  Returned from CA server.  Only read to migrate
+ * devices provisioned before #APP_PS_PROVISION.
  */
 #define APP_PS_TLS_CERT (APP_PS_BASE + 0x0001)
 
-/** MQTT Broker hub name.  Stored as a string.
+/** MQTT Broker hub name.  Stored as a string.  Only read to migrate.
  */
 #define APP_PS_HUBNAME (APP_PS_BASE + 0x0002)
 
-/** MQTT Broker port.  Stored as a uint16_t.
+/** MQTT Broker port.  Stored as a uint16_t.  Only read to migrate.
  */
 #define APP_PS_HUBPORT (APP_PS_BASE + 0x0003)
 
+/** Provisioning record.  A CBOR map holding the version, and the device
+ * certificate, hub name and port present.
+ */
+#define APP_PS_PROVISION (APP_PS_BASE + 0x0004)
+
+/** Layout version of the provisioning record. */
+#define PROVISION_RECORD_VERSION 1
+
+/** Largest device certificate kept in the provisioning cache. */
+#define PROVISION_CERT_MAX 1024
+
+/** Longest hub name kept in the provisioning cache. */
+#define PROVISION_HUBNAME_MAX 128
+
+/** Largest encoded provisioning record, room is left for the CBOR headers. */
+#define PROVISION_RECORD_MAX (PROVISION_CERT_MAX + PROVISION_HUBNAME_MAX + 32)
+
 /** Enum describing which fields are populated.
  */
 enum provision_present {
@@ -82,6 +100,17 @@ struct provision_data {
         uint16_t hubport;
 };
 
+/**
+ * @brief Load provisioning data from persistent storage.
+ *
+ * Reads whatever provisioning data an earlier bootstrap stored into an
+ * in-RAM cache, and wakes up anyone waiting on it.  Called once at boot.
+ *
+ * @return 0 if the data needed to reach the MQTT server is present, -ENOENT
+ * if the device still has to be bootstrapped.
+ */
+int provision_init(void);
+
 /**
  * @brief Wait until provisioning data is available.
  *
@@ -95,18 +124,21 @@ int provision_wait(enum provision_present mask);
 /**
  * @brief Set or create provisioning data.
  *
- * Stores the given provisioning data in persistent storage.  The pointers are
- * assumed to be held in something like a CBOR buffer, and will not outlive this
- * call.
+ * Stores the given provisioning data in persistent storage, and updates the
+ * in-RAM cache.  The pointers are assumed to be held in something like a CBOR
+ * buffer, and will not outlive this call.
+ *
+ * @return 0 on success, -ENOSPC if a field is too large for the cache, or
+ * -EINVAL if it could not be written to persistent storage.
  */
 int provision_store(const struct provision_data *prov);
 
 /**
  * @brief Read provisioning data.
  *
- * Attempts to read the provisioning data from non-volatile storage.  The
- * variable-sized entries will be placed into #buf, which has #buf_len bytes of
- * space available.
+ * Copies the cached provisioning data, without going to persistent storage.
+ * The variable-sized entries will be placed into #buf, which has #buf_len
+ * bytes of space available.
  *
  * @return If the buffer is not large enough to contain the results, will return
  * -ENOSPC.  If the persistent storage values are not present, will return
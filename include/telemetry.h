@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Called when the current batch should be published, either right
+ * away because it is full, or after CONFIG_AZURE_TELEMETRY_FLUSH_MS because
+ * its first result arrived.
+ *
+ * @param now  True when the batch is full.
+ */
+typedef void (*telemetry_ready_cb_t)(bool now);
+
+/**
+ * @brief Start producing telemetry.
+ *
+ * Background inference requests for COSE SIGN1 outputs are queued to the
+ * inference service every CONFIG_AZURE_TELEMETRY_INTERVAL_MS, and their
+ * results are packed into a batch as a CBOR array of COSE_Sign1 objects.
+ *
+ * @param ready  Callback asking for the batch to be published.
+ */
+void telemetry_start(telemetry_ready_cb_t ready);
+
+/**
+ * @brief Stop queueing inference requests. Results already in the batch
+ * stay there until taken.
+ */
+void telemetry_stop(void);
+
+/** A batch of results handed out by telemetry_take(). */
+struct telemetry_payload;
+
+/**
+ * @brief Take the current batch. A new batch is started with the next result.
+ *
+ * The results are encoded straight into a pool of payload buffers, so the
+ * batch is published from where it was encoded. The buffer stays in use
+ * until released with telemetry_release(), normally on the PUBACK.
+ *
+ * @param data  Set to the CBOR array holding the batched results.
+ * @param len   Set to the size of data in bytes.
+ *
+ * @return The batch, NULL if it was empty.
+ */
+struct telemetry_payload *telemetry_take(const uint8_t **data, size_t *len);
+
+/**
+ * @brief Return a batch taken with telemetry_take() to the pool.
+ *
+ * @param payload  The batch.
+ */
+void telemetry_release(struct telemetry_payload *payload);
+
+#endif /* TELEMETRY_H */
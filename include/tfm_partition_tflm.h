@@ -14,6 +14,29 @@
 extern "C" {
 #endif
 
+/** Header of one chunk of an input tensor upload, see
+ *  psa_si_tflm_input_upload(). offset and total are in float elements.
+ */
+typedef struct {
+	char model[32];
+	uint32_t slot;
+	uint32_t offset;
+	uint32_t total;
+} tflm_input_chunk_t;
+
+/** Streaming session operations, see psa_si_tflm_stream(). */
+typedef enum {
+	TFLM_STREAM_OPEN = 0,   /**< Reset the model state, start a stream. */
+	TFLM_STREAM_PUSH,       /**< Run the model on the next input frames. */
+	TFLM_STREAM_CLOSE,      /**< End the stream. */
+} tflm_stream_op_t;
+
+/** Header of a streaming session request, config is only used on open. */
+typedef struct {
+	uint32_t op;
+	infer_config_t config;
+} tflm_stream_req_t;
+
 // /**
 //  * \brief Read magnetometer (LSM303) data.
 //  *
@@ -30,6 +53,9 @@ extern "C" {
  * \brief Run secure inference to manipulate the sine value of input and
  *        encode and sign sine value using COSE CBOR
  *
+ * \param[in]   handle             Connection to the service, opened with
+ *                                 psa_connect(). The partition keeps a
+ *                                 session for it until it is closed.
  * \param[in]   infer_config       Inference config holds the encode format and
  *                                 model index which is used in secure
  *                                 inference service to find the model to use.
@@ -42,13 +68,100 @@ extern "C" {
  *
  * \return Returns error code as specified in \ref psa_status_t
  */
-psa_status_t psa_si_tflm_hello(infer_config_t *infer_config,
+psa_status_t psa_si_tflm_hello(psa_handle_t handle,
+			       infer_config_t *infer_config,
 			       void *input,
 			       size_t input_data_size,
 			       uint8_t *encoded_buf,
 			       size_t infval_enc_buf_size,
 			       size_t *encoded_buf_len);
 
+/**
+ * \brief Initialise a TFLM model in the secure partition ahead of the first
+ *        inference request. Models are otherwise initialised lazily.
+ *
+ * \param[in]   handle             Connection to the warmup service, opened
+ *                                 with psa_connect(). It has no session, so
+ *                                 it can be kept open for good.
+ * \param[in]   model              Null-terminated model name, e.g.
+ *                                 "TFLM_MODEL_SINE".
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t psa_si_tflm_warmup(psa_handle_t handle, const char *model);
+
+/**
+ * \brief Upload one chunk of an input tensor into a secure input slot, where
+ *        it is quantized for the model's input tensor.
+ *
+ * \param[in]   handle             Connection to the upload service, opened
+ *                                 with psa_connect(). It has no session, so
+ *                                 it can be kept open for good.
+ * \param[in]   chunk              Model, slot and position of the chunk.
+ * \param[in]   data               Float input values of the chunk.
+ * \param[in]   count              Number of values in data.
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t psa_si_tflm_input_upload(psa_handle_t handle,
+				      const tflm_input_chunk_t *chunk,
+				      const float *data,
+				      size_t count);
+
+/**
+ * \brief Same as psa_si_tflm_hello(), but runs inference on an input
+ *        previously uploaded with psa_si_tflm_input_upload(). The slot is
+ *        released once its input is loaded into the model.
+ *
+ * \param[in]   handle             Connection to the service, opened with
+ *                                 psa_connect(). The partition keeps a
+ *                                 session for it until it is closed.
+ * \param[in]   infer_config       Inference config, see psa_si_tflm_hello().
+ * \param[in]   slot               Input slot to run inference on.
+ * \param[out]  encoded_buf         Buffer to which encoded data
+ *                                  is written into
+ * \param[in]   encoded_buf_size    Size of encoded_buf in bytes
+ * \param[out]  encoded_buf_len     Encoded and signed payload len in bytes
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t psa_si_tflm_hello_slot(psa_handle_t handle,
+				    infer_config_t *infer_config,
+				    uint32_t slot,
+				    uint8_t *encoded_buf,
+				    size_t infval_enc_buf_size,
+				    size_t *encoded_buf_len);
+
+/**
+ * \brief Streaming inference session on a stateful TFLM model.
+ *
+ *        TFLM_STREAM_OPEN clears the model's variable tensors and stores the
+ *        output format. Each TFLM_STREAM_PUSH then runs the model on one or
+ *        more input frames, keeping the state left by the earlier pushes,
+ *        and returns the encoded output of the last frame. The stream
+ *        belongs to the connection it was opened on.
+ *
+ * \param[in]   handle             Connection to the service, opened with
+ *                                 psa_connect(). The partition keeps a
+ *                                 session for it until it is closed.
+ * \param[in]   req                Operation and, on open, inference config.
+ * \param[in]   samples            Input frames for TFLM_STREAM_PUSH.
+ * \param[in]   count              Number of float values in samples.
+ * \param[out]  encoded_buf         Buffer to which encoded data
+ *                                  is written into
+ * \param[in]   encoded_buf_size    Size of encoded_buf in bytes
+ * \param[out]  encoded_buf_len     Encoded and signed payload len in bytes
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t psa_si_tflm_stream(psa_handle_t handle,
+				const tflm_stream_req_t *req,
+				const float *samples,
+				size_t count,
+				uint8_t *encoded_buf,
+				size_t infval_enc_buf_size,
+				size_t *encoded_buf_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,9 @@ extern "C" {
  * sign model output value using COSE CBOR, model selection for inference
  * engine is based on infer_config_t member 'model' name.
  *
+ * \param[in]   handle             Connection to the service, opened with
+ *                                 psa_connect(). The partition keeps a
+ *                                 session for it until it is closed.
  * \param[in]   infer_config       Inference config holds the encode format and
  *                                 model index which is used in secure
  *                                 inference service to find the model to use.
@@ -31,12 +34,13 @@ extern "C" {
  *
  * \return Returns error code as specified in \ref psa_status_t
  */
-psa_status_t psa_si_utvm(infer_config_t *infer_config,
-			       void *input,
-			       size_t input_data_size,
-			       uint8_t *encoded_buf,
-			       size_t infval_enc_buf_size,
-			       size_t *encoded_buf_len);
+psa_status_t psa_si_utvm(psa_handle_t handle,
+			 infer_config_t *infer_config,
+			 void *input,
+			 size_t input_data_size,
+			 uint8_t *encoded_buf,
+			 size_t infval_enc_buf_size,
+			 size_t *encoded_buf_len);
 
 #ifdef __cplusplus
 }
@@ -21,6 +21,17 @@ supported_payload_type = ["INFERENCE", "AAT"]
 
 EAT_CBOR_LINARO_RANGE_BASE = -80000
 EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE         =  (EAT_CBOR_LINARO_RANGE_BASE - 0)
+EAT_CBOR_LINARO_LABEL_INFERENCE_TENSOR        =  (EAT_CBOR_LINARO_RANGE_BASE - 9)
+EAT_CBOR_LINARO_LABEL_QUANT_PARAMS            =  (EAT_CBOR_LINARO_RANGE_BASE - 10)
+
+# RFC 8746 multi-dimensional array tag, and the typed array tags mapped to
+# their struct format character.
+CBOR_TAG_MULTI_DIM_ARRAY = 40
+CBOR_TYPED_ARRAY_FORMAT = {
+    72: "b",    # sint8
+    77: "<h",   # sint16, little endian
+    85: "<f",   # float32, little endian
+}
 
 class EatCborLinaroAatClaim(Enum):
     TFLM_VERSION            =  (EAT_CBOR_LINARO_RANGE_BASE - 1)
@@ -95,13 +106,39 @@ def parse_args():
     return parser.parse_args()
 
 
+def cbor_decode_typed_array(tagged):
+    # Unpack an RFC 8746 typed array into a list of numbers.
+    fmt = CBOR_TYPED_ARRAY_FORMAT.get(tagged.tag)
+    if fmt is None:
+        raise ValueError("Unsupported typed array tag {}".format(tagged.tag))
+    return [v[0] for v in struct.iter_unpack(fmt, tagged.value)]
+
+def cbor_decode_tensor(tagged):
+    # Decode a row-major multi-dimensional typed array into its shape and
+    # flat list of elements.
+    if tagged.tag != CBOR_TAG_MULTI_DIM_ARRAY:
+        raise ValueError("Unexpected tensor tag {}".format(tagged.tag))
+    shape, elements = tagged.value
+    return shape, cbor_decode_typed_array(elements)
+
 def cbor_decode_infer_payload(cbor_enc_payload):
-    # Get the inference value from the passed cbor encoded
+    # Get the inference value or output tensor from the passed cbor encoded
     # payload in the Map major type.
     decode = cbor2.loads(cbor_enc_payload)
-    pprint(cbor2.loads(cbor_enc_payload))
-    infer_value = struct.unpack("f", decode[EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE])
-    print("Inference value from the payload::", infer_value)
+    pprint(decode)
+    if EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE in decode:
+        infer_value = struct.unpack("f", decode[EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE])
+        print("Inference value from the payload::", infer_value)
+        return
+
+    shape, values = cbor_decode_tensor(decode[EAT_CBOR_LINARO_LABEL_INFERENCE_TENSOR])
+    if EAT_CBOR_LINARO_LABEL_QUANT_PARAMS in decode:
+        scale, zero_point = decode[EAT_CBOR_LINARO_LABEL_QUANT_PARAMS]
+        scale = cbor_decode_typed_array(scale)[0]
+        print("Quantization scale:: {} zero point:: {}".format(scale, zero_point))
+        values = [(v - zero_point) * scale for v in values]
+    print("Inference tensor shape::", shape)
+    print("Inference tensor from the payload::", values)
 
 def cbor_decode_aat_payload(cbor_enc_payload):
     # Get the TFLM and MicroTVM version and its model version from the passed CBOR encoded
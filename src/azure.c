@@ -17,6 +17,8 @@
 #include <provision.h>
 #include "test_certs.h"
 #include "azure-config.h"
+#include "telemetry.h"
+#include "c2d.h"
 
 LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
 
@@ -51,6 +53,33 @@ static bool mqtt_connected;
 
 static struct k_work_delayable pub_message;
 
+/* Number of retransmissions of a QoS1 publish before it is given up. */
+#define PUB_RETRY_MAX 3
+
+/* Window of QoS1 telemetry publishes waiting for their PUBACK. Payloads are
+ * sent straight from the telemetry buffers, which are kept until then.
+ */
+static struct pub_inflight {
+	uint16_t message_id;
+	uint8_t retries;
+	int64_t sent;
+	const uint8_t *data;
+	size_t len;
+	struct telemetry_payload *payload;
+} pub_inflight[CONFIG_AZURE_MQTT_WINDOW];
+static K_MUTEX_DEFINE(pub_inflight_lock);
+
+/* Last message ID used, IDs are handed out in order and never 0. */
+static uint16_t pub_message_id = 1U;
+
+/* A batch is waiting for room in the window. */
+static bool pub_waiting;
+
+static struct k_work_delayable pub_retry;
+
+/* Reconnect delay, doubled after every failed attempt. */
+static uint32_t reconnect_backoff_ms = CONFIG_AZURE_RECONNECT_MIN_MS;
+
 #if defined(CONFIG_DNS_RESOLVER)
 static struct zsock_addrinfo hints;
 static struct zsock_addrinfo *haddr;
@@ -305,6 +334,8 @@ static void client_init(struct mqtt_client *client)
 	tls_config->sec_tag_list = m_sec_tags;
 	tls_config->sec_tag_count = ARRAY_SIZE(m_sec_tags);
 	tls_config->hostname = azure_hostname;
+	/* Resume the previous TLS session on reconnect, see user-tls.h */
+	tls_config->session_cache = TLS_SESSION_CACHE_ENABLED;
 
 #if defined(CONFIG_SOCKS)
 	mqtt_client_set_proxy(client, &socks5_proxy,
@@ -313,10 +344,49 @@ static void client_init(struct mqtt_client *client)
 #endif
 }
 
+/* Called with pub_inflight_lock held. */
+static void inflight_clear(struct pub_inflight *pub)
+{
+	telemetry_release(pub->payload);
+	pub->payload = NULL;
+
+	/* Room in the window for a batch that was held back */
+	if (pub_waiting) {
+		pub_waiting = false;
+		k_work_reschedule(&pub_message, K_NO_WAIT);
+	}
+}
+
+static void inflight_release(uint16_t message_id)
+{
+	k_mutex_lock(&pub_inflight_lock, K_FOREVER);
+	for (int i = 0; i < ARRAY_SIZE(pub_inflight); i++) {
+		if (pub_inflight[i].payload != NULL &&
+		    pub_inflight[i].message_id == message_id) {
+			inflight_clear(&pub_inflight[i]);
+			break;
+		}
+	}
+	k_mutex_unlock(&pub_inflight_lock);
+}
+
+/* Payloads still waiting for a PUBACK are lost with the connection. */
+static void inflight_release_all(void)
+{
+	k_mutex_lock(&pub_inflight_lock, K_FOREVER);
+	pub_waiting = false;
+	for (int i = 0; i < ARRAY_SIZE(pub_inflight); i++) {
+		if (pub_inflight[i].payload != NULL) {
+			inflight_clear(&pub_inflight[i]);
+		}
+	}
+	k_mutex_unlock(&pub_inflight_lock);
+}
+
 static void mqtt_event_handler(struct mqtt_client *const client, const struct mqtt_evt *evt)
 {
 	struct mqtt_puback_param puback;
-	uint8_t data[33];
+	uint8_t data[64];
 	int len;
 	int bytes_read;
 
@@ -344,6 +414,8 @@ static void mqtt_event_handler(struct mqtt_client *const client, const struct mq
 
 		mqtt_connected = false;
 		clear_fds();
+		telemetry_stop();
+		inflight_release_all();
 		break;
 
 	case MQTT_EVT_PUBACK:
@@ -353,6 +425,7 @@ static void mqtt_event_handler(struct mqtt_client *const client, const struct mq
 		}
 
 		LOG_DBG("PUBACK packet id: %u\n", evt->param.puback.message_id);
+		inflight_release(evt->param.puback.message_id);
 		break;
 
 	case MQTT_EVT_PUBLISH:
@@ -362,19 +435,20 @@ static void mqtt_event_handler(struct mqtt_client *const client, const struct mq
 		LOG_INF(" id: %d, qos: %d", evt->param.publish.message_id,
 			evt->param.publish.message.topic.qos);
 
+		/* Inference commands are decoded as they are read. */
+		c2d_begin();
 		while (len) {
-			bytes_read = mqtt_read_publish_payload(
-				&client_ctx, data,
-				len >= sizeof(data) - 1 ? sizeof(data) - 1 : len);
-			if (bytes_read < 0 && bytes_read != -EAGAIN) {
+			bytes_read = mqtt_read_publish_payload_blocking(
+				&client_ctx, data, MIN(len, sizeof(data)));
+			if (bytes_read <= 0) {
 				LOG_ERR("failure to read payload");
 				break;
 			}
 
-			data[bytes_read] = '\0';
-			// LOG_INF("   payload: %s", log_strdup(data));
+			c2d_feed(data, bytes_read);
 			len -= bytes_read;
 		}
+		c2d_end();
 
 		puback.message_id = evt->param.publish.message_id;
 		mqtt_publish_qos1_ack(&client_ctx, &puback);
@@ -403,44 +477,127 @@ static void subscribe(struct mqtt_client *client)
 	}
 }
 
+static void publish_param(struct mqtt_publish_param *param,
+			  const struct pub_inflight *pub, enum mqtt_qos qos)
+{
+	param->message.topic.qos = qos;
+	param->message.topic.topic.utf8 = (uint8_t *)event_topic;
+	param->message.topic.topic.size = strlen(event_topic);
+	param->message.payload.data = (uint8_t *)pub->data;
+	param->message.payload.len = pub->len;
+	param->message_id = pub->message_id;
+	param->dup_flag = 0U;
+	param->retain_flag = 0U;
+}
+
+/* Publish the telemetry batch, unless the window is full. The batch then
+ * stays with the producer, which stops queueing inference requests once
+ * its buffers are used up, and is published on the next PUBACK.
+ *
+ * The window lock is held across mqtt_publish(), the MQTT client drops its
+ * own lock before calling mqtt_event_handler().
+ */
 static int publish(struct mqtt_client *client, enum mqtt_qos qos)
 {
-	char payload[] = "{id=123}";
-	uint8_t len = strlen(event_topic);
+	struct pub_inflight *pub = NULL;
 	struct mqtt_publish_param param;
+	int rc;
 
-	param.message.topic.qos = qos;
-	param.message.topic.topic.utf8 = (uint8_t *)event_topic;
-	param.message.topic.topic.size = len;
-	param.message.payload.data = payload;
-	param.message.payload.len = strlen(payload);
-	param.message_id = sys_rand32_get();
-	param.dup_flag = 0U;
-	param.retain_flag = 0U;
+	k_mutex_lock(&pub_inflight_lock, K_FOREVER);
+	for (int i = 0; i < ARRAY_SIZE(pub_inflight); i++) {
+		if (pub_inflight[i].payload == NULL) {
+			pub = &pub_inflight[i];
+			break;
+		}
+	}
+
+	if (pub == NULL) {
+		pub_waiting = true;
+		rc = -EAGAIN;
+		goto out;
+	}
+
+	/* Batch of COSE_Sign1 inference results, as one CBOR array. */
+	pub->payload = telemetry_take(&pub->data, &pub->len);
+	if (pub->payload == NULL) {
+		rc = 0;
+		goto out;
+	}
 
-	return mqtt_publish(client, &param);
+	if (++pub_message_id == 0U) {
+		pub_message_id = 1U;
+	}
+	pub->message_id = pub_message_id;
+	pub->retries = 0U;
+	pub->sent = k_uptime_get();
+
+	publish_param(&param, pub, qos);
+	rc = mqtt_publish(client, &param);
+	if (rc || qos == MQTT_QOS_0_AT_MOST_ONCE) {
+		inflight_clear(pub);
+	} else {
+		k_work_schedule(&pub_retry, K_MSEC(CONFIG_AZURE_MQTT_RETRY_MS));
+	}
+
+out:
+	k_mutex_unlock(&pub_inflight_lock);
+
+	return rc;
 }
 
-static void poll_mqtt(void)
+/* Retransmit, with the DUP flag, every publish not acknowledged within
+ * CONFIG_AZURE_MQTT_RETRY_MS, and give up after PUB_RETRY_MAX tries.
+ */
+static void publish_retry(struct k_work *work)
 {
+	struct mqtt_publish_param param;
+	int64_t now = k_uptime_get();
+	int64_t next = 0;
 	int rc;
 
-	while (mqtt_connected) {
-		rc = wait(SYS_FOREVER_MS);
-		if (rc > 0) {
-			mqtt_input(&client_ctx);
+	if (!mqtt_connected) {
+		return;
+	}
+
+	k_mutex_lock(&pub_inflight_lock, K_FOREVER);
+	for (int i = 0; i < ARRAY_SIZE(pub_inflight); i++) {
+		struct pub_inflight *pub = &pub_inflight[i];
+		int64_t due = pub->sent + CONFIG_AZURE_MQTT_RETRY_MS;
+
+		if (pub->payload == NULL) {
+			continue;
+		}
+
+		if (due > now) {
+			next = (next == 0 || due < next) ? due : next;
+			continue;
+		}
+
+		if (pub->retries == PUB_RETRY_MAX) {
+			LOG_ERR("No PUBACK for message %u, dropped",
+				pub->message_id);
+			inflight_clear(pub);
+			continue;
+		}
+
+		pub->retries++;
+		pub->sent = now;
+		due = now + CONFIG_AZURE_MQTT_RETRY_MS;
+		next = (next == 0 || due < next) ? due : next;
+
+		publish_param(&param, pub, MQTT_QOS_1_AT_LEAST_ONCE);
+		param.dup_flag = 1U;
+		rc = mqtt_publish(&client_ctx, &param);
+		if (rc) {
+			LOG_ERR("mqtt_publish retry %u failed %d",
+				pub->message_id, rc);
 		}
 	}
-}
+	k_mutex_unlock(&pub_inflight_lock);
 
-/* Random time between 10 - 15 seconds
- * If you prefer to have this value more than CONFIG_MQTT_KEEPALIVE,
- * then keep the application connection live by calling mqtt_live()
- * in regular intervals.
- */
-static uint8_t timeout_for_publish(void)
-{
-	return (10 + sys_rand32_get() % 5);
+	if (next != 0) {
+		k_work_reschedule(&pub_retry, K_MSEC(next - now));
+	}
 }
 
 static void publish_timeout(struct k_work *work)
@@ -452,54 +609,108 @@ static void publish_timeout(struct k_work *work)
 	}
 
 	rc = publish(&client_ctx, MQTT_QOS_1_AT_LEAST_ONCE);
-	if (rc) {
+	if (rc == -EAGAIN) {
+		LOG_DBG("mqtt_publish window full");
+		return;
+	} else if (rc) {
 		LOG_ERR("mqtt_publish ERROR");
-		goto end;
+		return;
 	}
 
 	LOG_DBG("mqtt_publish OK");
-end:
-	k_work_reschedule(&pub_message, K_SECONDS(timeout_for_publish()));
 }
 
-static int try_to_connect(struct mqtt_client *client)
+/* Replies to inference commands go out on the event topic. They are small
+ * and sent as they come, so QoS 0 is used and the window is not involved.
+ */
+static void c2d_reply(const uint8_t *buf, size_t len)
 {
-	uint8_t retries = 3U;
+	struct mqtt_publish_param param;
 	int rc;
 
-	LOG_DBG("attempting to connect...");
+	if (!mqtt_connected) {
+		return;
+	}
 
-	while (retries--) {
-		client_init(client);
+	param.message.topic.qos = MQTT_QOS_0_AT_MOST_ONCE;
+	param.message.topic.topic.utf8 = (uint8_t *)event_topic;
+	param.message.topic.topic.size = strlen(event_topic);
+	param.message.payload.data = (uint8_t *)buf;
+	param.message.payload.len = len;
+	param.message_id = 0U;
+	param.dup_flag = 0U;
+	param.retain_flag = 0U;
 
-		rc = mqtt_connect(client);
-		if (rc) {
-			LOG_ERR("mqtt_connect failed %d", rc);
-			continue;
-		}
+	rc = mqtt_publish(&client_ctx, &param);
+	if (rc) {
+		LOG_ERR("Inference reply failed %d", rc);
+	}
+}
 
-		prepare_fds(client);
+/* A full batch is published right away, otherwise the batch is published
+ * CONFIG_AZURE_TELEMETRY_FLUSH_MS after its first result. k_work_schedule()
+ * keeps an earlier deadline if the work is already scheduled.
+ */
+static void telemetry_ready(bool now)
+{
+	if (now) {
+		k_work_reschedule(&pub_message, K_NO_WAIT);
+	} else {
+		k_work_schedule(&pub_message,
+				K_MSEC(CONFIG_AZURE_TELEMETRY_FLUSH_MS));
+	}
+}
 
-		rc = wait(APP_SLEEP_MSECS);
-		if (rc < 0) {
-			mqtt_abort(client);
-			return rc;
-		}
+static int try_to_connect(struct mqtt_client *client)
+{
+	int rc;
 
-		mqtt_input(client);
+	LOG_DBG("attempting to connect...");
 
-		if (mqtt_connected) {
-			subscribe(client);
-			k_work_reschedule(&pub_message, K_SECONDS(timeout_for_publish()));
-			return 0;
-		}
+	client_init(client);
 
+	rc = mqtt_connect(client);
+	if (rc) {
+		LOG_ERR("mqtt_connect failed %d", rc);
+		return rc;
+	}
+
+	prepare_fds(client);
+
+	rc = wait(APP_SLEEP_MSECS);
+	if (rc <= 0) {
 		mqtt_abort(client);
+		return rc < 0 ? rc : -ETIMEDOUT;
+	}
+
+	mqtt_input(client);
 
-		wait(10 * MSEC_PER_SEC);
+	if (!mqtt_connected) {
+		mqtt_abort(client);
+		return -ECONNREFUSED;
 	}
 
-	return -EINVAL;
+	subscribe(client);
+	telemetry_start(telemetry_ready);
+
+	/* Publish a batch held back while disconnected */
+	k_work_reschedule(&pub_message, K_NO_WAIT);
+
+	return 0;
+}
+
+/* Wait between half and all of the current backoff, so devices dropped by
+ * the same network blip don't reconnect in lockstep.
+ */
+static uint32_t reconnect_delay(void)
+{
+	uint32_t delay = reconnect_backoff_ms / 2U;
+
+	delay += sys_rand32_get() % (reconnect_backoff_ms / 2U + 1U);
+	reconnect_backoff_ms = MIN(reconnect_backoff_ms * 2U,
+				   CONFIG_AZURE_RECONNECT_MAX_MS);
+
+	return delay;
 }
 
 #if defined(CONFIG_DNS_RESOLVER)
@@ -528,24 +739,92 @@ static int get_mqtt_broker_addrinfo(void)
 }
 #endif
 
-static void connect_to_cloud_and_publish(void)
+static int connect_to_cloud(void)
 {
-	int rc = -EINVAL;
+	int rc;
 
 #if defined(CONFIG_DNS_RESOLVER)
-	rc = get_mqtt_broker_addrinfo();
-	if (rc) {
-		return;
+	if (haddr == NULL) {
+		rc = get_mqtt_broker_addrinfo();
+		if (rc) {
+			return rc;
+		}
 	}
 #endif
-#if 1
+
 	rc = try_to_connect(&client_ctx);
+
+#if defined(CONFIG_DNS_RESOLVER)
 	if (rc) {
-		return;
+		/* The hub may have moved, resolve it again next time */
+		zsock_freeaddrinfo(haddr);
+		haddr = NULL;
 	}
-
-	poll_mqtt();
 #endif
+
+	return rc;
+}
+
+/* Single loop serving the connection: it sleeps on the socket until input
+ * arrives or the next PINGREQ is due, and reconnects with a jittered
+ * exponential backoff when the connection is lost. Publishing is driven by
+ * the pub_message and pub_retry work items, which are kicked again on
+ * reconnect.
+ */
+static void mqtt_loop(struct mqtt_client *client)
+{
+	uint32_t delay;
+	short revents;
+	int rc;
+
+	while (1) {
+		if (!mqtt_connected) {
+			rc = connect_to_cloud();
+			if (rc) {
+				delay = reconnect_delay();
+				LOG_WRN("Azure connection failed %d, retrying in %u ms",
+					rc, delay);
+				k_sleep(K_MSEC(delay));
+				continue;
+			}
+
+			reconnect_backoff_ms = CONFIG_AZURE_RECONNECT_MIN_MS;
+		}
+
+		rc = wait(mqtt_keepalive_time_left(client));
+		if (rc < 0) {
+			mqtt_abort(client);
+			continue;
+		}
+
+		revents = rc > 0 ? fds[0].revents : 0;
+
+		if (revents & ZSOCK_POLLIN) {
+			rc = mqtt_input(client);
+			if (rc && mqtt_connected) {
+				LOG_ERR("mqtt_input failed %d", rc);
+				mqtt_abort(client);
+				continue;
+			}
+		}
+
+		if (revents & (ZSOCK_POLLERR | ZSOCK_POLLHUP | ZSOCK_POLLNVAL)) {
+			LOG_ERR("MQTT socket closed");
+			mqtt_abort(client);
+			continue;
+		}
+
+		if (!mqtt_connected) {
+			continue;
+		}
+
+		/* Sends a PINGREQ once the keepalive time is up */
+		rc = mqtt_live(client);
+		if (rc && rc != -EAGAIN) {
+			LOG_ERR("mqtt_live failed %d", rc);
+			mqtt_abort(client);
+		}
+	}
 }
 
 #define PRIORITY 7
@@ -583,12 +862,16 @@ void azure_thread(void)
 
 	/* Start a worker to publish messages when possible to do. */
 	k_work_init_delayable(&pub_message, publish_timeout);
+	k_work_init_delayable(&pub_retry, publish_retry);
+
+	/* Serve inference commands sent to the device topic. */
+	c2d_init(c2d_reply);
 
 	/* Sleep until the "azure start" command is given. */
 	k_sem_take(&mqtt_command_start, K_FOREVER);
 
 	LOG_INF("Connecting to Azure");
-	connect_to_cloud_and_publish();
+	mqtt_loop(&client_ctx);
 }
 
 K_THREAD_DEFINE(azure_worker, CONFIG_AZURE_STACK_SIZE, azure_thread, NULL, NULL, NULL, PRIORITY, 0,
@@ -54,6 +54,24 @@ struct rest_cb_data {
 	enum km_key_idx key_idx;
 };
 
+/* Room for the largest element of a batch CSR response. */
+#define BATCH_RSP_LEN 1024
+
+/* User data for the batch CSR callback.
+ */
+struct csr_batch_rsp {
+	uint8_t buf[BATCH_RSP_LEN];
+	size_t len;
+	bool in_array;
+	/* Elements in the response, and elements handled so far. */
+	uint32_t count;
+	uint32_t done;
+	int res;
+};
+
+/* Static to prevent stack overflow. */
+static struct csr_batch_rsp batch_rsp;
+
 #ifdef DEBUG_WALK_CBOR
 /* Walk a CBOR structure, at least with certain fields.  This can help
  * us understand how to use the nanocbor API.
@@ -199,24 +217,14 @@ static int decode_csr_response(struct provision_data *prov, const uint8_t *buf,
 	return res;
 }
 
-static void csr_cb(struct http_response *rsp, enum http_final_call final_data,
-			  void *user_data)
+/* Decode the response to the CSR of one key, and store the certificate. */
+static int handle_csr_response(const uint8_t *buf, size_t len, struct rest_cb_data *data)
 {
 	struct provision_data prov;
 	int res;
-	struct rest_cb_data *data = user_data;
-
-	if (final_data == HTTP_DATA_MORE) {
-		LOG_INF("Partial data %zd bytes", rsp->data_len);
-	} else if (final_data == HTTP_DATA_FINAL) {
-		LOG_INF("All data received %zd bytes", rsp->data_len);
-	}
-
-	LOG_INF("Response to req");
-	LOG_INF("Status %s", rsp->http_status);
 
 	memset(&prov, 0, sizeof(prov));
-	res = decode_csr_response(&prov, rsp->body_frag_start, rsp->content_length, data);
+	res = decode_csr_response(&prov, buf, len, data);
 	LOG_INF("Result: %d", res);
 
 	if (res >= 0) {
@@ -237,6 +245,117 @@ static void csr_cb(struct http_response *rsp, enum http_final_call final_data,
 	case KEY_COUNT:
 		break;
 	}
+
+	return res;
+}
+
+static void csr_cb(struct http_response *rsp, enum http_final_call final_data,
+			  void *user_data)
+{
+	struct rest_cb_data *data = user_data;
+
+	if (final_data == HTTP_DATA_MORE) {
+		LOG_INF("Partial data %zd bytes", rsp->data_len);
+	} else if (final_data == HTTP_DATA_FINAL) {
+		LOG_INF("All data received %zd bytes", rsp->data_len);
+	}
+
+	LOG_INF("Response to req");
+	LOG_INF("Status %s", rsp->http_status);
+
+	handle_csr_response(rsp->body_frag_start, rsp->content_length, data);
+}
+
+/* Decode the elements of a batch CSR response received so far.  Each
+ * complete element is handled and dropped from the buffer, so only the
+ * element being received is held.
+ *
+ * Returns 0 for success, or a negative errno on error. */
+static int decode_csr_batch(struct csr_batch_rsp *rsp)
+{
+	struct nanocbor_value decode;
+	struct nanocbor_value array;
+	struct nanocbor_value item;
+	struct rest_cb_data data;
+	const uint8_t *start;
+	size_t used = 0;
+	int res;
+
+	if (!rsp->in_array) {
+		nanocbor_decoder_init(&decode, rsp->buf, rsp->len);
+		res = nanocbor_enter_array(&decode, &array);
+		if (res == NANOCBOR_ERR_END) {
+			return 0;
+		} else if (res < 0) {
+			return -EINVAL;
+		}
+
+		rsp->count = nanocbor_container_remaining(&array);
+		rsp->in_array = true;
+		used = array.cur - rsp->buf;
+	}
+
+	while (rsp->done < rsp->count && rsp->done < KEY_COUNT) {
+		start = &rsp->buf[used];
+		nanocbor_decoder_init(&item, start, rsp->len - used);
+		res = nanocbor_skip(&item);
+		if (res == NANOCBOR_ERR_END) {
+			/* Wait for the rest of this element. */
+			break;
+		} else if (res < 0) {
+			return -EINVAL;
+		}
+
+		/* Responses come in the order of the requests. */
+		data.key_idx = rsp->done;
+		res = handle_csr_response(start, item.cur - start, &data);
+		if (res < 0) {
+			return res;
+		}
+
+		used += item.cur - start;
+		rsp->done++;
+	}
+
+	memmove(rsp->buf, &rsp->buf[used], rsp->len - used);
+	rsp->len -= used;
+
+	return 0;
+}
+
+static void csr_batch_cb(struct http_response *rsp, enum http_final_call final_data,
+			 void *user_data)
+{
+	struct csr_batch_rsp *batch = user_data;
+	const uint8_t *frag = rsp->body_frag_start;
+	size_t frag_len = rsp->body_frag_len;
+	size_t n;
+
+	if (frag == NULL) {
+		return;
+	}
+
+	/* Feed the fragment in pieces the buffer can take, each decode
+	 * frees the elements it completes. */
+	while (frag_len > 0 && batch->res == 0) {
+		n = MIN(frag_len, sizeof(batch->buf) - batch->len);
+		if (n == 0) {
+			LOG_ERR("CSR response element too large");
+			batch->res = -ENOSPC;
+			break;
+		}
+
+		memcpy(&batch->buf[batch->len], frag, n);
+		batch->len += n;
+		frag += n;
+		frag_len -= n;
+
+		batch->res = decode_csr_batch(batch);
+	}
+
+	if (final_data == HTTP_DATA_FINAL) {
+		LOG_INF("Batch CSR response: %u of %u certificates", batch->done, batch->count);
+	}
 }
 
 static int decode_service_response(struct provision_data *prov, const uint8_t *buf, size_t len)
@@ -386,9 +505,14 @@ static int set_bootstrap_cred(void)
 int bootstrap_open(struct bootstrap *ctx)
 {
 	int rc;
-	rc = get_bootstrap_addrinfo();
-	if (rc < 0) {
-		return rc;
+
+	/* The address is kept, so the TLS session cached for it is found on
+	 * the next connection. */
+	if (haddr == NULL) {
+		rc = get_bootstrap_addrinfo();
+		if (rc < 0) {
+			return rc;
+		}
 	}
 
 	int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TLS_1_2);
@@ -425,6 +549,16 @@ int bootstrap_open(struct bootstrap *ctx)
 		return rc;
 	}
 
+	/* Resume the session of the previous bootstrap connection, which
+	 * skips the ECDHE key exchange and the client key signature. */
+	int session_cache = TLS_SESSION_CACHE_ENABLED;
+	rc = zsock_setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE, &session_cache,
+			      sizeof(session_cache));
+	if (rc < 0) {
+		LOG_ERR("Failed to enable TLS session cache");
+		return rc;
+	}
+
 	struct sockaddr_in daddr;
 
 	daddr.sin_family = AF_INET;
@@ -491,6 +625,49 @@ int bootstrap_csr(struct bootstrap *ctx, struct csr_req *req, uint8_t key_idx)
 	return rest_call(ctx, req->cbor, req->cbor_len, HTTP_POST, "/api/v1/cr", csr_cb, &data);
 }
 
+int bootstrap_csr_all(struct bootstrap *ctx, struct csr_batch_req *req)
+{
+	nanocbor_encoder_t enc;
+	size_t len;
+	int rc;
+
+	int status = al_psa_status(km_get_uuid(req->uuid, sizeof(req->uuid)), __func__);
+	if (status != PSA_SUCCESS) {
+		return -EINVAL;
+	}
+
+	/* The CSRs are built straight into one CBOR array. */
+	nanocbor_encoder_init(&enc, req->cbor, sizeof(req->cbor));
+	nanocbor_fmt_array(&enc, KEY_COUNT);
+	req->cbor_len = nanocbor_encoded_len(&enc);
+
+	for (uint8_t key_idx = 0; key_idx < KEY_COUNT; key_idx++) {
+		len = sizeof(req->cbor) - req->cbor_len;
+		status = x509_csr_cbor(key_idx,
+				       &req->cbor[req->cbor_len],
+				       &len,
+				       req->uuid,
+				       sizeof(req->uuid));
+		if (status != PSA_SUCCESS) {
+			return -EINVAL;
+		}
+		req->cbor_len += len;
+	}
+
+	memset(&batch_rsp, 0, sizeof(batch_rsp));
+	rc = rest_call(ctx, req->cbor, req->cbor_len, HTTP_POST, "/api/v1/crs", csr_batch_cb,
+		       &batch_rsp);
+	if (rc < 0) {
+		return rc;
+	}
+
+	if (batch_rsp.res < 0) {
+		return batch_rsp.res;
+	}
+
+	return batch_rsp.done == KEY_COUNT ? 0 : -EIO;
+}
+
 int bootstrap_service(struct bootstrap *ctx)
 {
 	return rest_call(ctx, NULL, 0, HTTP_GET, "/api/v1/ccs", service_cb, NULL);
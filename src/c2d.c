@@ -0,0 +1,326 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/zephyr.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
+#include <nanocbor/nanocbor.h>
+
+#include "c2d.h"
+#include "infer_service.h"
+
+/** Declare a reference to the application logging interface. */
+LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* Room for the command map up to the header of the inputs. */
+#define C2D_HDR_MAX             32
+
+/* Commands whose replies can be outstanding at once. */
+#define C2D_JOBS                4
+
+/* Reply array header, job ID and input, in front of the output. */
+#define C2D_REPLY_HDR_MAX       16
+
+struct c2d_job {
+	uint32_t id;
+	/* Held by the decoder and by every queued request */
+	atomic_t ref;
+};
+
+static struct c2d_job c2d_jobs[C2D_JOBS];
+
+/* Decoder state of the command being read. */
+static struct {
+	uint8_t hdr[C2D_HDR_MAX];
+	size_t hdr_len;
+	bool parsed;
+	bool invalid;
+	struct c2d_job *job;
+	infer_request_t req;
+	size_t inputs_left;
+	uint8_t value[sizeof(float)];
+	size_t value_len;
+	uint32_t queued;
+	uint32_t dropped;
+} c2d;
+
+static c2d_reply_cb_t c2d_reply;
+static uint8_t c2d_reply_buf[C2D_REPLY_HDR_MAX + INFER_ENC_MAX_VALUE_SZ];
+static K_MUTEX_DEFINE(c2d_reply_lock);
+
+static struct c2d_job *c2d_job_alloc(uint32_t id)
+{
+	for (int i = 0; i < C2D_JOBS; i++) {
+		if (atomic_cas(&c2d_jobs[i].ref, 0, 1)) {
+			c2d_jobs[i].id = id;
+			return &c2d_jobs[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Send the reply to one input of a command.
+ *
+ * @param job     Job of the command.
+ * @param input   Input the reply is for.
+ * @param status  PSA status of the inference.
+ * @param out     Encoded inference output, only used on success.
+ * @param out_len Size of the output in bytes.
+ */
+static void c2d_send(const struct c2d_job *job, float input,
+		     psa_status_t status, const uint8_t *out, size_t out_len)
+{
+	nanocbor_encoder_t enc;
+	size_t len;
+
+	k_mutex_lock(&c2d_reply_lock, K_FOREVER);
+	nanocbor_encoder_init(&enc, c2d_reply_buf, C2D_REPLY_HDR_MAX);
+	nanocbor_fmt_array(&enc, 3);
+	nanocbor_fmt_uint(&enc, job->id);
+	nanocbor_fmt_float(&enc, input);
+	if (status != PSA_SUCCESS) {
+		nanocbor_fmt_int(&enc, status);
+		len = nanocbor_encoded_len(&enc);
+	} else {
+		/* The output is already CBOR, embed it as is */
+		len = nanocbor_encoded_len(&enc);
+		memcpy(&c2d_reply_buf[len], out, out_len);
+		len += out_len;
+	}
+
+	if (c2d_reply != NULL) {
+		c2d_reply(c2d_reply_buf, len);
+	}
+	k_mutex_unlock(&c2d_reply_lock);
+}
+
+static void c2d_result(const infer_result_t *res, void *user_data)
+{
+	struct c2d_job *job = res->req->tag;
+
+	ARG_UNUSED(user_data);
+
+	if (job < &c2d_jobs[0] || job >= &c2d_jobs[C2D_JOBS]) {
+		return;
+	}
+
+	c2d_send(job, res->req->input, res->status, res->buf, res->len);
+
+	atomic_dec(&job->ref);
+}
+
+static struct infer_subscriber c2d_sub = {
+	.cb = c2d_result,
+};
+
+/**
+ * @brief Decode the command up to the header of the inputs, whose content
+ * is then streamed.
+ *
+ * @return 0 on success, -EAGAIN if more bytes are needed, -EINVAL if the
+ * command is malformed.
+ */
+static int c2d_parse_header(size_t *used)
+{
+	nanocbor_value_t dec;
+	nanocbor_value_t map;
+	uint32_t key;
+	uint32_t val[3];
+	const uint8_t *p;
+	size_t avail;
+	size_t hdr;
+	uint8_t info;
+	uint32_t len;
+	int rc;
+
+	nanocbor_decoder_init(&dec, c2d.hdr, c2d.hdr_len);
+	rc = nanocbor_enter_map(&dec, &map);
+	if (rc < 0) {
+		goto err;
+	}
+
+	for (uint32_t k = 1; k <= 4; k++) {
+		rc = nanocbor_get_uint32(&map, &key);
+		if (rc < 0) {
+			goto err;
+		}
+
+		if (key != k) {
+			return -EINVAL;
+		}
+
+		if (k == 4) {
+			break;
+		}
+
+		rc = nanocbor_get_uint32(&map, &val[k - 1]);
+		if (rc < 0) {
+			goto err;
+		}
+	}
+
+	/* NanoCBOR wants the whole string, so decode its header by hand */
+	p = map.cur;
+	avail = map.end - map.cur;
+	if (avail == 0) {
+		return -EAGAIN;
+	}
+
+	/* Definite length only, with up to 4 length bytes */
+	info = p[0] & 0x1f;
+	if ((p[0] >> NANOCBOR_TYPE_OFFSET) != NANOCBOR_TYPE_BSTR || info > 26) {
+		return -EINVAL;
+	}
+
+	hdr = info < 24 ? 1 : 1 + (1 << (info - 24));
+	if (avail < hdr) {
+		return -EAGAIN;
+	}
+
+	switch (info) {
+	case 24:
+		len = p[1];
+		break;
+	case 25:
+		len = sys_get_be16(&p[1]);
+		break;
+	case 26:
+		len = sys_get_be32(&p[1]);
+		break;
+	default:
+		len = info;
+		break;
+	}
+
+	if (val[1] >= INFER_MODEL_COUNT || val[2] >= INFER_ENC_NONE ||
+	    len % sizeof(float) != 0) {
+		return -EINVAL;
+	}
+
+	c2d.job = c2d_job_alloc(val[0]);
+	if (c2d.job == NULL) {
+		LOG_ERR("Too many inference jobs, dropping job %u", val[0]);
+		return -EINVAL;
+	}
+
+	c2d.req.model = val[1];
+	c2d.req.enc_format = val[2];
+	c2d.req.out_format = INFER_OUT_FLOAT;
+	c2d.req.prio = INFER_PRIO_BACKGROUND;
+	c2d.req.tag = c2d.job;
+	c2d.inputs_left = len;
+	*used = (p + hdr) - c2d.hdr;
+
+	return 0;
+
+err:
+	return rc == NANOCBOR_ERR_END ? -EAGAIN : -EINVAL;
+}
+
+/* Commands are decoded on the MQTT thread, which must not wait for room in
+ * the inference queue, or no keepalive or PUBACK would be handled meanwhile.
+ * An input the queue has no room for is dropped, and its reply says so.
+ */
+static void c2d_submit(float input)
+{
+	c2d.req.input = input;
+
+	atomic_inc(&c2d.job->ref);
+	if (infer_service_submit(&c2d.req, K_NO_WAIT) != 0) {
+		atomic_dec(&c2d.job->ref);
+		c2d.dropped++;
+		c2d_send(c2d.job, input, PSA_ERROR_INSUFFICIENT_MEMORY,
+			 NULL, 0);
+		return;
+	}
+
+	c2d.queued++;
+}
+
+static void c2d_inputs(const uint8_t *buf, size_t len)
+{
+	uint32_t raw;
+	float input;
+
+	for (; len > 0 && c2d.inputs_left > 0; buf++, len--) {
+		c2d.value[c2d.value_len++] = *buf;
+		c2d.inputs_left--;
+
+		if (c2d.value_len == sizeof(c2d.value)) {
+			raw = sys_get_le32(c2d.value);
+			memcpy(&input, &raw, sizeof(input));
+			c2d_submit(input);
+			c2d.value_len = 0;
+		}
+	}
+}
+
+void c2d_init(c2d_reply_cb_t reply)
+{
+	c2d_reply = reply;
+	infer_service_subscribe(&c2d_sub);
+}
+
+void c2d_begin(void)
+{
+	memset(&c2d, 0, sizeof(c2d));
+}
+
+void c2d_feed(const uint8_t *buf, size_t len)
+{
+	size_t used;
+	size_t n;
+	int rc;
+
+	if (c2d.invalid) {
+		return;
+	}
+
+	if (!c2d.parsed) {
+		n = MIN(len, sizeof(c2d.hdr) - c2d.hdr_len);
+		memcpy(&c2d.hdr[c2d.hdr_len], buf, n);
+		c2d.hdr_len += n;
+		buf += n;
+		len -= n;
+
+		rc = c2d_parse_header(&used);
+		if (rc == -EAGAIN && c2d.hdr_len < sizeof(c2d.hdr)) {
+			return;
+		} else if (rc) {
+			c2d.invalid = true;
+			return;
+		}
+
+		/* Bytes read past the header already are inputs */
+		c2d.parsed = true;
+		c2d_inputs(&c2d.hdr[used], c2d.hdr_len - used);
+	}
+
+	c2d_inputs(buf, len);
+}
+
+int c2d_end(void)
+{
+	int rc = 0;
+
+	if (c2d.invalid || !c2d.parsed || c2d.inputs_left > 0) {
+		LOG_ERR("Invalid inference command");
+		rc = -EINVAL;
+	}
+
+	if (c2d.job != NULL) {
+		LOG_INF("Inference job %u: %u queued, %u dropped",
+			c2d.job->id, c2d.queued, c2d.dropped);
+		atomic_dec(&c2d.job->ref);
+		c2d.job = NULL;
+	}
+
+	return rc;
+}
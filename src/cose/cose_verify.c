@@ -46,27 +46,289 @@ int cose_sign1_decode(const uint8_t *obj,
 	return COSE_ERROR_NONE;
 }
 
-int cose_payload_decode(const uint8_t *obj,
-			const size_t len_obj,
-			float *inf_sig_value)
+/**
+ * @brief Decode an unsigned claim, encoded either as a CBOR uint or as a
+ *        byte string holding the value in native byte order.
+ */
+static int cose_claim_get_uint(nanocbor_value_t *map,
+			       void *value,
+			       size_t len_value)
 {
-	nanocbor_value_t nc, arr;
-	size_t pld_len = sizeof(float);
-	uint8_t temp = 0;
-	uint8_t *sig = &temp;
+	const uint8_t *buf;
+	size_t len_buf;
+	uint32_t val32;
+	int rc;
+
+	if (nanocbor_get_type(map) == NANOCBOR_TYPE_UINT) {
+		if (len_value == sizeof(uint64_t)) {
+			rc = nanocbor_get_uint64(map, (uint64_t *)value);
+		} else {
+			rc = nanocbor_get_uint32(map, (uint32_t *)value);
+		}
+		return rc < 0 ? COSE_ERROR_DECODE : COSE_ERROR_NONE;
+	}
+
+	if (nanocbor_get_bstr(map, &buf, &len_buf) < 0 ||
+	    len_buf > len_value) {
+		return COSE_ERROR_DECODE;
+	}
+	if (len_value == sizeof(uint64_t) && len_buf == sizeof(uint32_t)) {
+		memcpy(&val32, buf, len_buf);
+		*(uint64_t *)value = val32;
+	} else if (len_buf == len_value) {
+		memcpy(value, buf, len_buf);
+	} else {
+		return COSE_ERROR_DECODE;
+	}
+	return COSE_ERROR_NONE;
+}
+
+/* Size of one tensor element, 0 for an unknown type */
+static size_t cose_tensor_elem_size(cose_tensor_type_t type)
+{
+	switch (type) {
+	case COSE_TENSOR_NONE:
+	case COSE_TENSOR_FLOAT32:
+		return sizeof(float);
+	case COSE_TENSOR_INT8:
+		return sizeof(int8_t);
+	case COSE_TENSOR_INT16:
+		return sizeof(int16_t);
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Decode an RFC 8746 multi-dimensional typed array:
+ *        40([[dims...], typed-array-tag(bstr)])
+ */
+static int cose_claim_get_tensor(nanocbor_value_t *map,
+				 cose_infer_payload_t *out)
+{
+	nanocbor_value_t arr, dims;
+	size_t len_left = map->end - map->cur;
+	uint32_t tag;
+	size_t count = 1;
 
+	if (nanocbor_get_tag(map, &tag) < 0 ||
+	    tag != COSE_CBOR_TAG_MULTI_DIM_ARRAY ||
+	    nanocbor_enter_array(map, &arr) < 0 ||
+	    nanocbor_enter_array(&arr, &dims) < 0) {
+		return COSE_ERROR_DECODE;
+	}
+
+	/* Every element takes at least a byte of the payload, which bounds
+	 * the count before each multiplication.
+	 */
+	out->dims_len = 0;
+	while (!nanocbor_at_end(&dims)) {
+		if (out->dims_len == COSE_TENSOR_MAX_DIMS ||
+		    nanocbor_get_uint32(&dims,
+					&out->dims[out->dims_len]) < 0 ||
+		    out->dims[out->dims_len] == 0 ||
+		    count > len_left / out->dims[out->dims_len]) {
+			return COSE_ERROR_DECODE;
+		}
+		count *= out->dims[out->dims_len++];
+	}
+	nanocbor_leave_container(&arr, &dims);
+
+	if (nanocbor_get_tag(&arr, &tag) < 0) {
+		return COSE_ERROR_DECODE;
+	}
+	switch (tag) {
+	case COSE_CBOR_TAG_TA_FLOAT32_LE:
+		out->tensor_type = COSE_TENSOR_FLOAT32;
+		break;
+	case COSE_CBOR_TAG_TA_SINT8:
+		out->tensor_type = COSE_TENSOR_INT8;
+		break;
+	case COSE_CBOR_TAG_TA_SINT16_LE:
+		out->tensor_type = COSE_TENSOR_INT16;
+		break;
+	default:
+		return COSE_ERROR_UNSUPPORTED;
+	}
+
+	if (out->dims_len == 0 ||
+	    nanocbor_get_bstr(&arr, &out->value, &out->len_value) < 0 ||
+	    out->len_value != count * cose_tensor_elem_size(out->tensor_type)) {
+		return COSE_ERROR_DECODE;
+	}
+	nanocbor_leave_container(map, &arr);
+
+	return COSE_ERROR_NONE;
+}
+
+/**
+ * @brief Decode the quantization parameters: [85(scale), zero_point]
+ */
+static int cose_claim_get_quant(nanocbor_value_t *map,
+				cose_infer_payload_t *out)
+{
+	nanocbor_value_t arr;
+	const uint8_t *scale;
+	size_t len_scale;
+	uint32_t tag;
+
+	if (nanocbor_enter_array(map, &arr) < 0 ||
+	    nanocbor_get_tag(&arr, &tag) < 0 ||
+	    tag != COSE_CBOR_TAG_TA_FLOAT32_LE ||
+	    nanocbor_get_bstr(&arr, &scale, &len_scale) < 0 ||
+	    len_scale != sizeof(out->scale) ||
+	    nanocbor_get_int32(&arr, &out->zero_point) < 0) {
+		return COSE_ERROR_DECODE;
+	}
+	memcpy(&out->scale, scale, sizeof(out->scale));
+	nanocbor_leave_container(map, &arr);
+
+	out->has_quant = true;
+	return COSE_ERROR_NONE;
+}
+
+int cose_payload_decode_claims(const uint8_t *obj,
+			       const size_t len_obj,
+			       cose_infer_payload_t *out)
+{
+	nanocbor_value_t nc, map;
+	bool has_rollover = false;
+	int32_t label;
+	int status;
+
+	memset(out, 0, sizeof(*out));
 	nanocbor_decoder_init(&nc, obj, len_obj);
 
-	if (nanocbor_enter_map(&nc, &arr) < 0) {
+	if (nanocbor_enter_map(&nc, &map) < 0) {
 		return COSE_ERROR_DECODE;
 	}
 
-	nanocbor_skip(&arr);
-	nanocbor_get_bstr(&arr, (const uint8_t **)&sig, &pld_len);
-	*inf_sig_value = *(float *)sig;
+	while (!nanocbor_at_end(&map)) {
+		if (nanocbor_get_int32(&map, &label) < 0) {
+			return COSE_ERROR_DECODE;
+		}
+
+		switch (label) {
+		case EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE:
+			status = nanocbor_get_bstr(&map,
+						   &out->value,
+						   &out->len_value) < 0 ?
+				 COSE_ERROR_DECODE : COSE_ERROR_NONE;
+			out->tensor_type = COSE_TENSOR_NONE;
+			break;
+		case EAT_CBOR_LINARO_LABEL_INFERENCE_TENSOR:
+			status = cose_claim_get_tensor(&map, out);
+			break;
+		case EAT_CBOR_LINARO_LABEL_QUANT_PARAMS:
+			status = cose_claim_get_quant(&map, out);
+			break;
+		case EAT_CBOR_LINARO_NV_COUNTER_ROLL_OVER:
+			status = cose_claim_get_uint(&map,
+						     &out->nv_rollover,
+						     sizeof(out->nv_rollover));
+			has_rollover = true;
+			break;
+		case EAT_CBOR_LINARO_NV_COUNTER_VALUE:
+			status = cose_claim_get_uint(&map,
+						     &out->nv_counter,
+						     sizeof(out->nv_counter));
+			out->has_nv_counter = true;
+			break;
+		case EAT_CBOR_LINARO_LABEL_MODEL_ID:
+			if (nanocbor_get_type(&map) == NANOCBOR_TYPE_TSTR) {
+				status = nanocbor_get_tstr(&map,
+							   &out->model_id,
+							   &out->len_model_id);
+			} else {
+				status = nanocbor_get_bstr(&map,
+							   &out->model_id,
+							   &out->len_model_id);
+			}
+			status = status < 0 ? COSE_ERROR_DECODE : COSE_ERROR_NONE;
+			break;
+		case EAT_CBOR_LINARO_LABEL_TIMESTAMP:
+			status = cose_claim_get_uint(&map,
+						     &out->timestamp,
+						     sizeof(out->timestamp));
+			out->has_timestamp = true;
+			break;
+		default:
+			/* Claim not known to this decoder */
+			status = nanocbor_skip(&map) < 0 ?
+				 COSE_ERROR_DECODE : COSE_ERROR_NONE;
+			break;
+		}
+
+		if (status != COSE_ERROR_NONE) {
+			return status;
+		}
+	}
+
+	out->has_nv_counter = out->has_nv_counter && has_rollover;
+	if (out->value == NULL) {
+		return COSE_ERROR_DECODE;
+	}
+
+	return COSE_ERROR_NONE;
+}
+
+size_t cose_payload_get_count(const cose_infer_payload_t *pld)
+{
+	size_t elem_size = cose_tensor_elem_size(pld->tensor_type);
+
+	return elem_size ? pld->len_value / elem_size : 0;
+}
+
+int cose_payload_get_float(const cose_infer_payload_t *pld,
+			   size_t idx,
+			   float *value)
+{
+	const uint8_t *elem;
+	int16_t q16;
+	int32_t q;
+
+	if (idx >= cose_payload_get_count(pld)) {
+		return COSE_ERROR_DECODE;
+	}
+
+	/* Elements are not aligned within the payload. */
+	elem = &pld->value[idx * cose_tensor_elem_size(pld->tensor_type)];
+	switch (pld->tensor_type) {
+	case COSE_TENSOR_INT8:
+		q = (int8_t)*elem;
+		break;
+	case COSE_TENSOR_INT16:
+		memcpy(&q16, elem, sizeof(q16));
+		q = q16;
+		break;
+	default:
+		memcpy(value, elem, sizeof(float));
+		return COSE_ERROR_NONE;
+	}
+
+	if (pld->has_quant) {
+		*value = (q - pld->zero_point) * pld->scale;
+	} else {
+		*value = q;
+	}
 	return COSE_ERROR_NONE;
 }
 
+int cose_payload_decode(const uint8_t *obj,
+			const size_t len_obj,
+			float *inf_sig_value)
+{
+	cose_infer_payload_t pld;
+	int status;
+
+	status = cose_payload_decode_claims(obj, len_obj, &pld);
+	if (status != COSE_ERROR_NONE) {
+		return status;
+	}
+
+	return cose_payload_get_float(&pld, 0, inf_sig_value);
+}
+
 #if CONFIG_NONSECURE_COSE_VERIFY_SIGN
 static int cose_encode_prot(nanocbor_encoder_t *nc)
 {
@@ -76,54 +338,134 @@ static int cose_encode_prot(nanocbor_encoder_t *nc)
 	return nanocbor_encoded_len(nc);
 }
 
+/* Maximum size of the serialized body_protected header. */
+#define COSE_PROT_MAX_LEN 8
+
+/* SHA256 state after the constant part of ToBeSigned, built once by
+ * cose_verify_init() and only read afterwards.
+ */
+static mbedtls_md_context_t cose_sign1_prefix;
+static bool cose_sign1_prefix_ready;
+
 /**
- * @brief Calculate a SHA256 hash for SIGN1 verification.
+ * @brief Hash the part of ToBeSigned that comes before the payload.
  *
- * @param pld           Payload buffer.
- * @param len_pld       Size of the payload buffer.
- * @param hash          Placeholder for the calculated hash value.
- * @return int
+ * The array header, context string, body_protected and the empty
+ * external_aad only depend on the algorithm, so they are hashed once and
+ * the resulting digest state is cloned for every SIGN1 object.
  */
-int cose_sign1_hash(const uint8_t *pld,
-		    const size_t len_pld,
-		    uint8_t *hash)
+int cose_verify_init(void)
 {
-	mbedtls_md_context_t md_ctx;
-
-	mbedtls_md_setup(&md_ctx,
-			 mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
-			 0);
-	mbedtls_md_starts(&md_ctx);
 	nanocbor_encoder_t nc;
+	uint8_t prot[COSE_PROT_MAX_LEN];
+	size_t len_prot;
+	size_t len_buf = 8;
+	uint8_t buf[len_buf];
 
-	/* serialize body_protected */
-	nanocbor_encoder_init(&nc, NULL, 0);
-	size_t len_prot = cose_encode_prot(&nc);
-	uint8_t prot[len_prot];
+	if (cose_sign1_prefix_ready) {
+		return COSE_ERROR_NONE;
+	}
 
-	nanocbor_encoder_init(&nc, prot, len_prot);
-	cose_encode_prot(&nc);
+	/* serialize body_protected */
+	nanocbor_encoder_init(&nc, prot, sizeof(prot));
+	len_prot = cose_encode_prot(&nc);
 
-	/* serialize and hash ToBeSigned */
-	size_t len_buf = 8;
-	uint8_t buf[len_buf];
+	mbedtls_md_init(&cose_sign1_prefix);
+	if (mbedtls_md_setup(&cose_sign1_prefix,
+			     mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+			     0) ||
+	    mbedtls_md_starts(&cose_sign1_prefix)) {
+		mbedtls_md_free(&cose_sign1_prefix);
+		return COSE_ERROR_HASH;
+	}
 
+	/* serialize and hash ToBeSigned up to the payload */
 	nanocbor_encoder_init(&nc, buf, len_buf);
 	nanocbor_fmt_array(&nc, 4);
-	mbedtls_md_update(&md_ctx, buf, nanocbor_encoded_len(&nc));
+	mbedtls_md_update(&cose_sign1_prefix, buf, nanocbor_encoded_len(&nc));
 
-	HASH_TSTR(md_ctx, nc, buf, len_buf, COSE_CONTEXT_SIGN1)
-	HASH_BSTR(md_ctx, nc, buf, len_buf, prot, len_prot)
+	HASH_TSTR(cose_sign1_prefix, nc, buf, len_buf, COSE_CONTEXT_SIGN1)
+	HASH_BSTR(cose_sign1_prefix, nc, buf, len_buf, prot, len_prot)
 	/* external_aad. There is none so an empty bstr */
-	HASH_BSTR(md_ctx, nc, buf, len_buf, NULL, 0)
-	HASH_BSTR(md_ctx, nc, buf, len_buf, pld, len_pld)
+	HASH_BSTR(cose_sign1_prefix, nc, buf, len_buf, NULL, 0)
+
+	cose_sign1_prefix_ready = true;
+	return COSE_ERROR_NONE;
+}
 
-	if (mbedtls_md_finish(&md_ctx, hash)) {
+/**
+ * @brief Hash the ToBeSigned structure of a SIGN1 object.
+ *
+ * @param md_ctx        Message digest context, already set up for SHA256.
+ * @param pld           Payload buffer.
+ * @param len_pld       Size of the payload buffer.
+ * @param hash          Placeholder for the calculated hash value.
+ * @return int
+ */
+static int cose_sign1_hash_tbs(mbedtls_md_context_t *md_ctx,
+			       const uint8_t *pld,
+			       const size_t len_pld,
+			       uint8_t *hash)
+{
+	nanocbor_encoder_t nc;
+	size_t len_buf = 8;
+	uint8_t buf[len_buf];
+
+	if (mbedtls_md_clone(md_ctx, &cose_sign1_prefix)) {
+		return COSE_ERROR_HASH;
+	}
+
+	HASH_BSTR((*md_ctx), nc, buf, len_buf, pld, len_pld)
+
+	if (mbedtls_md_finish(md_ctx, hash)) {
+		return COSE_ERROR_HASH;
+	}
+	return COSE_ERROR_NONE;
+}
+
+/**
+ * @brief Set up a SHA256 context that ToBeSigned prefix can be cloned into.
+ *
+ * @param md_ctx        Pointer to the uninitialized digest context.
+ * @return int
+ */
+static int cose_sign1_hash_setup(mbedtls_md_context_t *md_ctx)
+{
+	mbedtls_md_init(md_ctx);
+	if (!cose_sign1_prefix_ready ||
+	    mbedtls_md_setup(md_ctx,
+			     mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+			     0)) {
+		mbedtls_md_free(md_ctx);
 		return COSE_ERROR_HASH;
 	}
 	return COSE_ERROR_NONE;
 }
 
+/**
+ * @brief Calculate a SHA256 hash for SIGN1 verification.
+ *
+ * @param pld           Payload buffer.
+ * @param len_pld       Size of the payload buffer.
+ * @param hash          Placeholder for the calculated hash value.
+ * @return int
+ */
+int cose_sign1_hash(const uint8_t *pld,
+		    const size_t len_pld,
+		    uint8_t *hash)
+{
+	mbedtls_md_context_t md_ctx;
+	int status;
+
+	if (cose_sign1_hash_setup(&md_ctx)) {
+		return COSE_ERROR_HASH;
+	}
+
+	status = cose_sign1_hash_tbs(&md_ctx, pld, len_pld, hash);
+	mbedtls_md_free(&md_ctx);
+	return status;
+}
+
 int cose_sign_init(cose_sign_context_t *ctx)
 {
 	mbedtls_ecp_group_id grp_id =
@@ -139,6 +481,34 @@ int cose_sign_init(cose_sign_context_t *ctx)
 	return COSE_ERROR_NONE;
 }
 
+/**
+ * @brief Verify the signature over an already computed ToBeSigned hash.
+ */
+static int cose_sign1_verify_hash(cose_sign_context_t *ctx,
+				  const uint8_t *hash,
+				  const uint8_t *sig,
+				  size_t len_sig)
+{
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+	if (ctx->has_precomp) {
+		if (mbedtls_ecdsa_precomp_verify(
+			    &ctx->precomp,
+			    hash, ctx->len_hash, sig, len_sig) != 0) {
+			return COSE_ERROR_AUTHENTICATE;
+		}
+		return COSE_ERROR_NONE;
+	}
+#endif
+
+	if (mbedtls_ecdsa_verify_sign(
+		    ctx->pk,
+		    hash, ctx->len_hash, sig, len_sig) != 0) {
+		return COSE_ERROR_AUTHENTICATE;
+	}
+
+	return COSE_ERROR_NONE;
+}
+
 int cose_verify_sign1(cose_sign_context_t *ctx,
 		      const uint8_t *obj,
 		      const size_t len_obj,
@@ -162,18 +532,159 @@ int cose_verify_sign1(cose_sign_context_t *ctx,
 		return COSE_ERROR_HASH;
 	}
 
-	if (mbedtls_ecdsa_verify_sign(
-		    ctx->pk,
-		    hash, ctx->len_hash, sig, len_sig) != 0) {
-		return COSE_ERROR_AUTHENTICATE;
+	return cose_sign1_verify_hash(ctx, hash, sig, len_sig);
+}
+
+int cose_verify_sign1_batch(cose_sign_context_t *ctx,
+			    const uint8_t *const objs[],
+			    const size_t lens[],
+			    size_t n,
+			    int results[])
+{
+	mbedtls_md_context_t md_ctx;
+	uint8_t hash[ctx->len_hash];
+	const uint8_t *pld, *sig;
+	size_t len_pld, len_sig;
+	int status = COSE_ERROR_NONE;
+
+	/* The digest setup is shared by the batch, only the payload and the
+	 * signature differ per object.
+	 */
+	if (cose_sign1_hash_setup(&md_ctx)) {
+		for (size_t i = 0; i < n; i++) {
+			results[i] = COSE_ERROR_HASH;
+		}
+		return COSE_ERROR_HASH;
 	}
 
-	return COSE_ERROR_NONE;
+	for (size_t i = 0; i < n; i++) {
+		sig = NULL;
+		if (cose_sign1_decode(objs[i], lens[i],
+				      &pld, &len_pld,
+				      &sig, &len_sig) || sig == NULL) {
+			results[i] = COSE_ERROR_DECODE;
+		} else if (cose_sign1_hash_tbs(&md_ctx, pld, len_pld, hash)) {
+			results[i] = COSE_ERROR_HASH;
+		} else {
+			results[i] = cose_sign1_verify_hash(ctx, hash,
+							    sig, len_sig);
+		}
+
+		if (status == COSE_ERROR_NONE) {
+			status = results[i];
+		}
+	}
+
+	mbedtls_md_free(&md_ctx);
+	return status;
 }
 
 void cose_sign_free(cose_sign_context_t *ctx)
 {
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+	if (ctx->has_precomp) {
+		mbedtls_ecdsa_precomp_free(&ctx->precomp);
+		ctx->has_precomp = false;
+	}
+#endif
 	mbedtls_pk_free(&ctx->pk);
 }
 
+/** Verification context cached for a key. */
+struct cose_verify_cache {
+	/** Context holds a loaded public key. */
+	bool valid;
+	/** Key generation the public key was loaded from. */
+	uint32_t generation;
+	cose_sign_context_t ctx;
+};
+
+static struct cose_verify_cache verify_cache[KEY_COUNT];
+
+/* Held from cose_verify_ctx_get() to cose_verify_ctx_put(), so that a cached
+ * context is neither reloaded nor used by two threads at once.
+ */
+static K_MUTEX_DEFINE(verify_cache_lock);
+
+int cose_verify_ctx_get(enum km_key_idx key_idx, cose_sign_context_t **ctx)
+{
+	struct km_key_context *km_ctx = km_get_context(key_idx);
+	struct cose_verify_cache *entry;
+	uint8_t pubkey[KM_PUBLIC_KEY_SIZE];
+	int status;
+
+	if (km_ctx == NULL) {
+		return COSE_ERROR_KEY;
+	}
+
+	k_mutex_lock(&verify_cache_lock, K_FOREVER);
+
+	entry = &verify_cache[key_idx];
+	if (entry->valid && entry->generation == km_ctx->generation) {
+		*ctx = &entry->ctx;
+		return COSE_ERROR_NONE;
+	}
+
+	cose_verify_ctx_invalidate(key_idx);
+
+	if (km_get_pubkey(pubkey, sizeof(pubkey), key_idx) != PSA_SUCCESS) {
+		status = COSE_ERROR_KEY;
+		goto err;
+	}
+
+	if (mbedtls_ecp_load_pubkey(&entry->ctx.pk,
+				    pubkey,
+				    sizeof(pubkey)) != 0) {
+		mbedtls_pk_free(&entry->ctx.pk);
+		status = COSE_ERROR_KEY;
+		goto err;
+	}
+
+	status = cose_sign_init(&entry->ctx);
+	if (status != COSE_ERROR_NONE) {
+		mbedtls_pk_free(&entry->ctx.pk);
+		goto err;
+	}
+
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+	/* Without the tables verification still works on the generic path. */
+	entry->ctx.has_precomp =
+		(mbedtls_ecdsa_precomp_init(&entry->ctx.precomp,
+					    &entry->ctx.pk) == 0);
+#endif
+
+	entry->generation = km_ctx->generation;
+	entry->valid = true;
+	*ctx = &entry->ctx;
+
+	return COSE_ERROR_NONE;
+err:
+	k_mutex_unlock(&verify_cache_lock);
+	return status;
+}
+
+void cose_verify_ctx_put(cose_sign_context_t *ctx)
+{
+	ARG_UNUSED(ctx);
+
+	k_mutex_unlock(&verify_cache_lock);
+}
+
+void cose_verify_ctx_invalidate(enum km_key_idx key_idx)
+{
+	struct cose_verify_cache *entry;
+
+	if (key_idx < 0 || key_idx >= KEY_COUNT) {
+		return;
+	}
+
+	k_mutex_lock(&verify_cache_lock, K_FOREVER);
+	entry = &verify_cache[key_idx];
+	if (entry->valid) {
+		cose_sign_free(&entry->ctx);
+		entry->valid = false;
+	}
+	k_mutex_unlock(&verify_cache_lock);
+}
+
 #endif /* CONFIG_NONSECURE_COSE_VERIFY_SIGN */
@@ -4,6 +4,8 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 #include <zephyr/logging/log.h>
+#include <zephyr/random/rand32.h>
+#include <mbedtls/version.h>
 
 #include "cose/mbedtls_ecdsa_verify_sign.h"
 #include "util_app_log.h"
@@ -11,6 +13,23 @@
 /** Declare a reference to the application logging interface. */
 LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
 
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+/* mbedTLS only keeps the comb table of a group's base point with the
+ * fixed-point speed-up enabled. Without it, both tables would be built again
+ * on every verification, which is slower than the generic path.
+ */
+#if !defined(MBEDTLS_ECP_FIXED_POINT_OPTIM) || !MBEDTLS_ECP_FIXED_POINT_OPTIM
+#error "CONFIG_NONSECURE_COSE_VERIFY_PRECOMP requires MBEDTLS_ECP_FIXED_POINT_OPTIM"
+#endif
+
+/* mbedtls_ecdsa_precomp_init() sets up a group by hand, which depends on
+ * mbedTLS internals that are only checked against the 3.x releases.
+ */
+#if MBEDTLS_VERSION_NUMBER < 0x03000000 || MBEDTLS_VERSION_NUMBER >= 0x04000000
+#error "CONFIG_NONSECURE_COSE_VERIFY_PRECOMP is untested with this mbedTLS version"
+#endif
+#endif
+
 int mbedtls_ecp_load_pubkey(mbedtls_pk_context *ctx,
 			    const uint8_t *data,
 			    size_t data_length)
@@ -120,3 +139,204 @@ err:
 	mbedtls_mpi_free(&s);
 	return status;
 }
+
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+/*
+ * Randomness is only used by the comb method to blind the intermediate
+ * points. Every input of a signature verification is public, so a
+ * non-cryptographic source is sufficient here.
+ */
+static int ecdsa_precomp_rng(void *ctx, unsigned char *buf, size_t len)
+{
+	sys_rand_get(buf, len);
+	return 0;
+}
+
+int mbedtls_ecdsa_precomp_init(mbedtls_ecdsa_precomp_context *ctx,
+			       const mbedtls_pk_context *pk)
+{
+	const mbedtls_ecp_keypair *kp = mbedtls_pk_ec(*pk);
+	mbedtls_ecp_point tmp;
+	mbedtls_mpi one;
+	int status;
+
+	mbedtls_ecp_group_init(&ctx->grp);
+	mbedtls_ecp_group_init(&ctx->grp_q);
+	mbedtls_ecp_point_init(&tmp);
+	mbedtls_mpi_init(&one);
+
+	status = mbedtls_ecp_group_load(&ctx->grp,
+					kp->MBEDTLS_PRIVATE(grp).id);
+	if (status != 0) {
+		goto err;
+	}
+
+	/* Same curve with Q as the base point, so that the comb table built
+	 * by the first multiplication by "G" is kept in the group and reused
+	 * for every later verification. The static table of the real
+	 * generator, if any, must not be used for Q.
+	 *
+	 * This relies on the following mbedTLS behaviour:
+	 * - ecp_mul_comb() stores the table it builds in grp->T, with
+	 *   grp->T_size set, when P is grp->G and no table is set, and
+	 *   mbedtls_ecp_group_free() frees such a table;
+	 * - for the built-in curves, which have h == 1,
+	 *   mbedtls_ecp_group_free() does not free G, so our copy of Q is
+	 *   freed by mbedtls_ecdsa_precomp_free().
+	 */
+	status = mbedtls_ecp_group_load(&ctx->grp_q,
+					kp->MBEDTLS_PRIVATE(grp).id);
+	if (status != 0) {
+		goto err;
+	}
+	ctx->grp_q.MBEDTLS_PRIVATE(T) = NULL;
+	ctx->grp_q.MBEDTLS_PRIVATE(T_size) = 0;
+	/* G points at the constant curve parameters, which must neither be
+	 * written nor freed, so it is replaced by a point of our own.
+	 */
+	mbedtls_ecp_point_init(&ctx->grp_q.G);
+	status = mbedtls_ecp_copy(&ctx->grp_q.G, &kp->MBEDTLS_PRIVATE(Q));
+	if (status != 0) {
+		goto err;
+	}
+
+	/* Build the table for Q now rather than on the first verification. */
+	status = mbedtls_mpi_lset(&one, 1);
+	if (status != 0) {
+		goto err;
+	}
+	status = mbedtls_ecp_mul(&ctx->grp_q, &tmp, &one, &ctx->grp_q.G,
+				 ecdsa_precomp_rng, NULL);
+	if (status != 0) {
+		goto err;
+	}
+
+	mbedtls_ecp_point_free(&tmp);
+	mbedtls_mpi_free(&one);
+	return status;
+err:
+	LOG_ERR("Precomputing the verification tables failed.\n");
+	al_dump_log();
+	mbedtls_ecp_point_free(&tmp);
+	mbedtls_mpi_free(&one);
+	mbedtls_ecdsa_precomp_free(ctx);
+	return status;
+}
+
+/*
+ * Verify an ECDSA signature as R = u1 * G + u2 * Q, with both
+ * multiplications done by the comb method on cached tables.
+ */
+int mbedtls_ecdsa_precomp_verify(mbedtls_ecdsa_precomp_context *ctx,
+				 const unsigned char *hash,
+				 size_t hash_len,
+				 const unsigned char *sig,
+				 size_t sig_len)
+{
+	mbedtls_ecp_group *grp = &ctx->grp;
+	size_t n_size = (grp->nbits + 7) / 8;
+	mbedtls_ecp_point R, R1, R2;
+	mbedtls_mpi r, s, e, s_inv, u1, u2, one;
+	int status;
+
+	mbedtls_ecp_point_init(&R);
+	mbedtls_ecp_point_init(&R1);
+	mbedtls_ecp_point_init(&R2);
+	mbedtls_mpi_init(&r);
+	mbedtls_mpi_init(&s);
+	mbedtls_mpi_init(&e);
+	mbedtls_mpi_init(&s_inv);
+	mbedtls_mpi_init(&u1);
+	mbedtls_mpi_init(&u2);
+	mbedtls_mpi_init(&one);
+
+	status = MBEDTLS_ERR_ECP_VERIFY_FAILED;
+	if (sig_len != 2 * n_size ||
+	    mbedtls_mpi_read_binary(&r, sig, n_size) ||
+	    mbedtls_mpi_read_binary(&s, &sig[n_size], n_size)) {
+		LOG_ERR("Failed to read the signature.\n");
+		goto err;
+	}
+
+	/* r and s must be in [1, n - 1]. */
+	if (mbedtls_mpi_cmp_int(&r, 1) < 0 ||
+	    mbedtls_mpi_cmp_mpi(&r, &grp->N) >= 0 ||
+	    mbedtls_mpi_cmp_int(&s, 1) < 0 ||
+	    mbedtls_mpi_cmp_mpi(&s, &grp->N) >= 0) {
+		goto err;
+	}
+
+	/* e is the leftmost nbits of the hash. */
+	if (mbedtls_mpi_read_binary(&e, hash,
+				    hash_len > n_size ? n_size : hash_len) ||
+	    (hash_len * 8 > grp->nbits &&
+	     mbedtls_mpi_shift_r(&e, n_size * 8 - grp->nbits))) {
+		goto err;
+	}
+
+	/* u1 = e / s mod n, u2 = r / s mod n */
+	if (mbedtls_mpi_inv_mod(&s_inv, &s, &grp->N) ||
+	    mbedtls_mpi_mul_mpi(&u1, &e, &s_inv) ||
+	    mbedtls_mpi_mod_mpi(&u1, &u1, &grp->N) ||
+	    mbedtls_mpi_mul_mpi(&u2, &r, &s_inv) ||
+	    mbedtls_mpi_mod_mpi(&u2, &u2, &grp->N) ||
+	    mbedtls_mpi_lset(&one, 1)) {
+		goto err;
+	}
+
+	/* The comb method only takes scalars in [1, n - 1]. A zero u1 needs a
+	 * forged hash, so it is fine to take the generic path for it.
+	 */
+	if (mbedtls_mpi_cmp_int(&u1, 0) == 0) {
+		status = mbedtls_ecdsa_verify(grp, hash, hash_len,
+					      &ctx->grp_q.G, &r, &s);
+		goto done;
+	}
+
+	if (mbedtls_ecp_mul(grp, &R1, &u1, &grp->G,
+			    ecdsa_precomp_rng, NULL) ||
+	    mbedtls_ecp_mul(&ctx->grp_q, &R2, &u2, &ctx->grp_q.G,
+			    ecdsa_precomp_rng, NULL) ||
+	    mbedtls_ecp_muladd(grp, &R, &one, &R1, &one, &R2)) {
+		goto err;
+	}
+
+	if (mbedtls_ecp_is_zero(&R)) {
+		goto err;
+	}
+
+	/* Accept if R.x mod n == r */
+	if (mbedtls_mpi_mod_mpi(&R.MBEDTLS_PRIVATE(X),
+				&R.MBEDTLS_PRIVATE(X),
+				&grp->N) ||
+	    mbedtls_mpi_cmp_mpi(&R.MBEDTLS_PRIVATE(X), &r) != 0) {
+		goto err;
+	}
+
+	status = 0;
+	goto done;
+err:
+	LOG_ERR("Signature verification failed.\n");
+	al_dump_log();
+done:
+	mbedtls_ecp_point_free(&R);
+	mbedtls_ecp_point_free(&R1);
+	mbedtls_ecp_point_free(&R2);
+	mbedtls_mpi_free(&r);
+	mbedtls_mpi_free(&s);
+	mbedtls_mpi_free(&e);
+	mbedtls_mpi_free(&s_inv);
+	mbedtls_mpi_free(&u1);
+	mbedtls_mpi_free(&u2);
+	mbedtls_mpi_free(&one);
+	return status;
+}
+
+void mbedtls_ecdsa_precomp_free(mbedtls_ecdsa_precomp_context *ctx)
+{
+	/* The group only frees G when it is not a built-in curve. */
+	mbedtls_ecp_point_free(&ctx->grp_q.G);
+	mbedtls_ecp_group_free(&ctx->grp);
+	mbedtls_ecp_group_free(&ctx->grp_q);
+}
+#endif /* CONFIG_NONSECURE_COSE_VERIFY_PRECOMP */
@@ -193,6 +193,7 @@ static psa_status_t psa_huk_deriv_ec_key(const uint8_t *rx_label,
 	LOG_DBG("PSA: Import key: 0x%x", ctx->key_handle);
 	ctx->local_private_len = sizeof(key_template);
 	ctx->status = KEY_GEN;
+	ctx->generation++;
 
 	LOG_INF("Successfully derived the key for %s", rx_label);
 
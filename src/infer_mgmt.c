@@ -8,6 +8,7 @@
 
 #include "cose/cose_verify.h"
 #include "cose/mbedtls_ecdsa_verify_sign.h"
+#include "psa/client.h"
 #include "psa_manifest/sid.h"
 #include "tfm_partition_tflm.h"
 #include "tfm_partition_utvm.h"
@@ -17,6 +18,49 @@
 /** Declare a reference to the application logging interface. */
 LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
 
+/* Connections kept open to the secure inference services. The partitions
+ * bind a session to each inference and stream connection, so the validated
+ * inference config and any stream state survive from one call to the next.
+ * The warmup and upload services are stateless, their connections are kept
+ * open only to save a connect per call.
+ */
+static psa_handle_t infer_tflm_handle;
+static psa_handle_t infer_tflm_stream_handle;
+static psa_handle_t infer_tflm_warmup_handle;
+static psa_handle_t infer_tflm_upload_handle;
+static psa_handle_t infer_utvm_handle;
+static K_MUTEX_DEFINE(infer_session_lock);
+
+/**
+ * @brief Get the connection to a secure inference service, opening it on
+ * first use.
+ *
+ * @param handle   Cached connection handle.
+ * @param sid      Service ID.
+ * @param version  Service version.
+ *
+ * @return psa_status_t
+ */
+static psa_status_t infer_session_get(psa_handle_t *handle,
+				      uint32_t sid,
+				      uint32_t version)
+{
+	psa_status_t status = PSA_SUCCESS;
+
+	/* Inference worker threads may race for the first connection */
+	k_mutex_lock(&infer_session_lock, K_FOREVER);
+	if (!PSA_HANDLE_IS_VALID(*handle)) {
+		*handle = psa_connect(sid, version);
+		if (!PSA_HANDLE_IS_VALID(*handle)) {
+			status = PSA_HANDLE_TO_ERROR(*handle);
+			*handle = PSA_NULL_HANDLE;
+		}
+	}
+	k_mutex_unlock(&infer_session_lock);
+
+	return status;
+}
+
 /**
  * @brief Initialize the supplied inference model context
  *
@@ -49,34 +93,26 @@ void infer_model_ctx_init(infer_ctx_t *ctx,
 #if CONFIG_NONSECURE_COSE_VERIFY_SIGN
 psa_status_t infer_verify_signature(uint8_t *infval_enc_buf,
 				    size_t infval_enc_buf_len,
-				    uint8_t *pubkey,
-				    size_t pubkey_len,
+				    enum km_key_idx key_idx,
 				    float *out_val)
 {
 	uint8_t *dec;
 	size_t len_dec;
-	cose_sign_context_t ctx;
+	cose_sign_context_t *ctx;
 	int status;
 
-	status = mbedtls_ecp_load_pubkey(&ctx.pk,
-					 pubkey,
-					 pubkey_len);
-	if (status != 0) {
-		LOG_ERR("Load the public key failed\n");
-		goto err;
-	}
-
-	status = cose_sign_init(&ctx);
+	status = cose_verify_ctx_get(key_idx, &ctx);
 	if (status != COSE_ERROR_NONE) {
-		LOG_ERR("Failed to initialize COSE signing context.\n");
+		LOG_ERR("Failed to get the COSE verification context.\n");
 		goto err;
 	}
 
-	status = cose_verify_sign1(&ctx,
+	status = cose_verify_sign1(ctx,
 				   infval_enc_buf,
 				   infval_enc_buf_len,
 				   (const uint8_t **) &dec,
 				   &len_dec);
+	cose_verify_ctx_put(ctx);
 	if (status != COSE_ERROR_NONE) {
 		LOG_ERR("Failed to authenticate signature.\n");
 		goto err;
@@ -90,7 +126,34 @@ psa_status_t infer_verify_signature(uint8_t *infval_enc_buf,
 	return status;
 err:
 	al_dump_log();
-	cose_sign_free(&ctx);
+	return status;
+}
+
+int infer_verify_signature_batch(const uint8_t *const infval_enc_bufs[],
+				 const size_t infval_enc_lens[],
+				 size_t count,
+				 enum km_key_idx key_idx,
+				 int results[])
+{
+	cose_sign_context_t *ctx;
+	int status;
+
+	status = cose_verify_ctx_get(key_idx, &ctx);
+	if (status != COSE_ERROR_NONE) {
+		LOG_ERR("Failed to get the COSE verification context.\n");
+		for (size_t i = 0; i < count; i++) {
+			results[i] = status;
+		}
+		return status;
+	}
+
+	status = cose_verify_sign1_batch(ctx,
+					 infval_enc_bufs,
+					 infval_enc_lens,
+					 count,
+					 results);
+	cose_verify_ctx_put(ctx);
+
 	return status;
 }
 #endif /* CONFIG_NONSECURE_COSE_VERIFY_SIGN */
@@ -134,6 +197,7 @@ err:
 }
 
 psa_status_t infer_get_tflm_cose_output(infer_enc_t enc_format,
+					infer_out_t out_format,
 					const char *model,
 					void  *input,
 					size_t input_size,
@@ -144,10 +208,19 @@ psa_status_t infer_get_tflm_cose_output(infer_enc_t enc_format,
 	psa_status_t status;
 	infer_config_t infer_config;
 
+	status = infer_session_get(&infer_tflm_handle,
+				   TFM_TFLM_SERVICE_HELLO_SID,
+				   TFM_TFLM_SERVICE_HELLO_VERSION);
+	if (status != PSA_SUCCESS) {
+		return al_psa_status(status, __func__);
+	}
+
 	infer_config.enc_format = enc_format;
+	infer_config.out_format = out_format;
 	sprintf(infer_config.models, "%s", model);
 	status = al_psa_status(
-		psa_si_tflm_hello(&infer_config,
+		psa_si_tflm_hello(infer_tflm_handle,
+				  &infer_config,
 				  input,
 				  input_size,
 				  infval_enc_buf,
@@ -161,7 +234,182 @@ psa_status_t infer_get_tflm_cose_output(infer_enc_t enc_format,
 	return status;
 }
 
+psa_status_t infer_tflm_warmup(const char *model)
+{
+	psa_status_t status;
+
+	status = infer_session_get(&infer_tflm_warmup_handle,
+				   TFM_TFLM_MODEL_WARMUP_SERVICE_SID,
+				   TFM_TFLM_MODEL_WARMUP_SERVICE_VERSION);
+	if (status == PSA_SUCCESS) {
+		status = psa_si_tflm_warmup(infer_tflm_warmup_handle, model);
+	}
+	status = al_psa_status(status, __func__);
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Failed to warm up %s", model);
+	}
+	return status;
+}
+
+psa_status_t infer_tflm_input_upload(const char *model,
+				     uint32_t slot,
+				     const float *input,
+				     size_t count)
+{
+	psa_status_t status = PSA_SUCCESS;
+	tflm_input_chunk_t chunk = { 0 };
+	size_t n;
+
+	if (slot >= INFER_INPUT_SLOTS ||
+	    strlen(model) >= sizeof(chunk.model)) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	status = infer_session_get(&infer_tflm_upload_handle,
+				   TFM_TFLM_INPUT_UPLOAD_SERVICE_SID,
+				   TFM_TFLM_INPUT_UPLOAD_SERVICE_VERSION);
+	if (status != PSA_SUCCESS) {
+		return al_psa_status(status, __func__);
+	}
+
+	strcpy(chunk.model, model);
+	chunk.slot = slot;
+	chunk.total = count;
+	for (chunk.offset = 0; chunk.offset < count; chunk.offset += n) {
+		n = count - chunk.offset;
+		if (n > INFER_INPUT_CHUNK_SZ) {
+			n = INFER_INPUT_CHUNK_SZ;
+		}
+		status = al_psa_status(
+			psa_si_tflm_input_upload(infer_tflm_upload_handle,
+						 &chunk,
+						 input + chunk.offset,
+						 n),
+			__func__);
+		if (status != PSA_SUCCESS) {
+			LOG_ERR("Failed to upload %s input at %d",
+				model, chunk.offset);
+			break;
+		}
+	}
+	return status;
+}
+
+psa_status_t infer_get_tflm_cose_output_slot(infer_enc_t enc_format,
+					     infer_out_t out_format,
+					     const char *model,
+					     uint32_t slot,
+					     uint8_t *infval_enc_buf,
+					     size_t infval_enc_buf_size,
+					     size_t *infval_enc_buf_len)
+{
+	psa_status_t status;
+	infer_config_t infer_config;
+
+	status = infer_session_get(&infer_tflm_handle,
+				   TFM_TFLM_SERVICE_HELLO_SID,
+				   TFM_TFLM_SERVICE_HELLO_VERSION);
+	if (status != PSA_SUCCESS) {
+		return al_psa_status(status, __func__);
+	}
+
+	infer_config.enc_format = enc_format;
+	infer_config.out_format = out_format;
+	sprintf(infer_config.models, "%s", model);
+	status = al_psa_status(
+		psa_si_tflm_hello_slot(infer_tflm_handle,
+				       &infer_config,
+				       slot,
+				       infval_enc_buf,
+				       infval_enc_buf_size,
+				       infval_enc_buf_len),
+		__func__);
+
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Failed to run inference on input slot %d", slot);
+	}
+	return status;
+}
+
+psa_status_t infer_tflm_stream_open(infer_enc_t enc_format,
+				    infer_out_t out_format,
+				    const char *model)
+{
+	psa_status_t status;
+	tflm_stream_req_t req = { .op = TFLM_STREAM_OPEN };
+
+	status = infer_session_get(&infer_tflm_stream_handle,
+				   TFM_TFLM_STREAM_SERVICE_SID,
+				   TFM_TFLM_STREAM_SERVICE_VERSION);
+	if (status != PSA_SUCCESS) {
+		return al_psa_status(status, __func__);
+	}
+
+	req.config.enc_format = enc_format;
+	req.config.out_format = out_format;
+	sprintf(req.config.models, "%s", model);
+	status = al_psa_status(
+		psa_si_tflm_stream(infer_tflm_stream_handle,
+				   &req, NULL, 0, NULL, 0, NULL),
+		__func__);
+
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Failed to open %s stream", model);
+	}
+	return status;
+}
+
+psa_status_t infer_tflm_stream_push(const float *samples,
+				    size_t count,
+				    uint8_t *infval_enc_buf,
+				    size_t infval_enc_buf_size,
+				    size_t *infval_enc_buf_len)
+{
+	psa_status_t status;
+	tflm_stream_req_t req = { .op = TFLM_STREAM_PUSH };
+
+	if (!PSA_HANDLE_IS_VALID(infer_tflm_stream_handle)) {
+		return PSA_ERROR_BAD_STATE;
+	}
+
+	status = al_psa_status(
+		psa_si_tflm_stream(infer_tflm_stream_handle,
+				   &req,
+				   samples,
+				   count,
+				   infval_enc_buf,
+				   infval_enc_buf_size,
+				   infval_enc_buf_len),
+		__func__);
+
+	if (status != PSA_SUCCESS) {
+		LOG_ERR("Failed to push stream samples");
+	}
+	return status;
+}
+
+psa_status_t infer_tflm_stream_close(void)
+{
+	psa_status_t status;
+	tflm_stream_req_t req = { .op = TFLM_STREAM_CLOSE };
+
+	if (!PSA_HANDLE_IS_VALID(infer_tflm_stream_handle)) {
+		return PSA_SUCCESS;
+	}
+
+	status = al_psa_status(psa_si_tflm_stream(infer_tflm_stream_handle,
+						  &req, NULL, 0, NULL, 0, NULL),
+			       __func__);
+
+	/* Dropping the connection releases the secure session as well */
+	psa_close(infer_tflm_stream_handle);
+	infer_tflm_stream_handle = PSA_NULL_HANDLE;
+
+	return status;
+}
+
 psa_status_t infer_get_utvm_cose_output(infer_enc_t enc_format,
+					infer_out_t out_format,
 					const char *model,
 					void  *input,
 					size_t input_size,
@@ -172,11 +420,20 @@ psa_status_t infer_get_utvm_cose_output(infer_enc_t enc_format,
 	psa_status_t status;
 	infer_config_t infer_config;
 
+	status = infer_session_get(&infer_utvm_handle,
+				   TFM_UTVM_SINE_MODEL_SERVICE_SID,
+				   TFM_UTVM_SINE_MODEL_SERVICE_VERSION);
+	if (status != PSA_SUCCESS) {
+		return al_psa_status(status, __func__);
+	}
+
 	infer_config.enc_format = enc_format;
+	infer_config.out_format = out_format;
 	sprintf(infer_config.models, "%s", model);
 
 	status = al_psa_status(
-		psa_si_utvm(&infer_config,
+		psa_si_utvm(infer_utvm_handle,
+			    &infer_config,
 			    input,
 			    input_size,
 			    infval_enc_buf,
@@ -215,4 +472,11 @@ void infer_init()
 			     TFM_UTVM_SINE_MODEL_SERVICE_VERSION,
 			     INFER_MODEL_STS_ACTIVE,
 			     "utvm_sine");
+
+#if CONFIG_NONSECURE_COSE_VERIFY_SIGN
+	/* Build the shared SIGN1 hash state before any worker can verify. */
+	if (cose_verify_init() != COSE_ERROR_NONE) {
+		LOG_ERR("Failed to initialise COSE verification.\n");
+	}
+#endif
 }
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/zephyr.h>
+#include <zephyr/logging/log.h>
+
+#include "infer_service.h"
+
+/** Declare a reference to the application logging interface. */
+LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* Inference engine entry point and secure model name of each model. */
+static const struct {
+	infer_get_cose_output cose_output;
+	const char *name;
+} infer_service_models[INFER_MODEL_COUNT] = {
+	[INFER_MODEL_TFLM_SINE] = { infer_get_tflm_cose_output, "TFLM_MODEL_SINE" },
+	[INFER_MODEL_UTVM_SINE] = { infer_get_utvm_cose_output, "UTVM_MODEL_SINE" },
+};
+
+/* One bounded queue per scheduling class. */
+K_MSGQ_DEFINE(infer_queue_interactive, sizeof(infer_request_t),
+	      CONFIG_INFER_SERVICE_QUEUE_DEPTH, 4);
+K_MSGQ_DEFINE(infer_queue_background, sizeof(infer_request_t),
+	      CONFIG_INFER_SERVICE_QUEUE_DEPTH, 4);
+
+static struct k_msgq *const infer_queue[INFER_PRIO_COUNT] = {
+	[INFER_PRIO_INTERACTIVE] = &infer_queue_interactive,
+	[INFER_PRIO_BACKGROUND] = &infer_queue_background,
+};
+
+/* Counts the requests waiting in all queues, workers sleep on it. */
+static K_SEM_DEFINE(infer_pending, 0, K_SEM_MAX_LIMIT);
+
+static sys_slist_t infer_subscribers = SYS_SLIST_STATIC_INIT(&infer_subscribers);
+static K_MUTEX_DEFINE(infer_subscribers_lock);
+
+static K_THREAD_STACK_ARRAY_DEFINE(infer_worker_stack,
+				   CONFIG_INFER_SERVICE_THREADS,
+				   CONFIG_INFER_SERVICE_STACK_SIZE);
+static struct k_thread infer_worker_thread[CONFIG_INFER_SERVICE_THREADS];
+
+/* Encoded output of the request each worker is serving. */
+static uint8_t infer_worker_buf[CONFIG_INFER_SERVICE_THREADS][INFER_ENC_MAX_VALUE_SZ];
+
+static void infer_service_publish(const infer_result_t *res)
+{
+	struct infer_subscriber *sub;
+
+	k_mutex_lock(&infer_subscribers_lock, K_FOREVER);
+	SYS_SLIST_FOR_EACH_CONTAINER(&infer_subscribers, sub, node) {
+		sub->cb(res, sub->user_data);
+	}
+	k_mutex_unlock(&infer_subscribers_lock);
+}
+
+/**
+ * @brief Take the next request, interactive requests first.
+ */
+static void infer_service_next(infer_request_t *req)
+{
+	k_sem_take(&infer_pending, K_FOREVER);
+
+	for (int i = 0; i < INFER_PRIO_COUNT; i++) {
+		if (k_msgq_get(infer_queue[i], req, K_NO_WAIT) == 0) {
+			return;
+		}
+	}
+
+	/* Every put is followed by a give, so a request is always there. */
+	__ASSERT(false, "inference queues out of sync");
+}
+
+static void infer_service_worker(void *p1, void *p2, void *p3)
+{
+	uint8_t *worker_buf = p1;
+	infer_request_t req;
+	infer_result_t res;
+
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (1) {
+		uint8_t *buf = worker_buf;
+		size_t size = INFER_ENC_MAX_VALUE_SZ;
+
+		infer_service_next(&req);
+
+		/* Encode straight into the requester's buffer when given one */
+		if (req.out != NULL) {
+			buf = req.out;
+			size = req.out_size;
+		}
+
+		res.req = &req;
+		res.buf = buf;
+		res.len = 0;
+		res.status = infer_service_models[req.model].cose_output(
+			req.enc_format,
+			req.out_format,
+			infer_service_models[req.model].name,
+			&req.input,
+			sizeof(req.input),
+			buf,
+			size,
+			&res.len);
+
+		infer_service_publish(&res);
+	}
+}
+
+#if CONFIG_INFER_SERVICE_LOG_RESULTS
+static void infer_service_log(const infer_result_t *res, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+	if (res->status != PSA_SUCCESS) {
+		LOG_ERR("Inference on %s failed: %d",
+			infer_service_models[res->req->model].name, res->status);
+		return;
+	}
+
+	LOG_INF("Inference on %s: %d bytes",
+		infer_service_models[res->req->model].name, (int)res->len);
+}
+
+static struct infer_subscriber infer_service_logger = {
+	.cb = infer_service_log,
+};
+#endif
+
+void infer_service_init(void)
+{
+	for (int i = 0; i < CONFIG_INFER_SERVICE_THREADS; i++) {
+		k_thread_create(&infer_worker_thread[i],
+				infer_worker_stack[i],
+				K_THREAD_STACK_SIZEOF(infer_worker_stack[i]),
+				infer_service_worker,
+				infer_worker_buf[i], NULL, NULL,
+				CONFIG_INFER_SERVICE_PRIORITY, 0, K_NO_WAIT);
+		k_thread_name_set(&infer_worker_thread[i], "infer_worker");
+	}
+
+#if CONFIG_INFER_SERVICE_LOG_RESULTS
+	infer_service_subscribe(&infer_service_logger);
+#endif
+}
+
+int infer_service_submit(const infer_request_t *req, k_timeout_t timeout)
+{
+	int rc;
+
+	if (req->model >= INFER_MODEL_COUNT || req->prio >= INFER_PRIO_COUNT) {
+		return -EINVAL;
+	}
+
+	rc = k_msgq_put(infer_queue[req->prio], req, timeout);
+	if (rc) {
+		return rc;
+	}
+
+	k_sem_give(&infer_pending);
+
+	return 0;
+}
+
+void infer_service_subscribe(struct infer_subscriber *sub)
+{
+	k_mutex_lock(&infer_subscribers_lock, K_FOREVER);
+	sys_slist_append(&infer_subscribers, &sub->node);
+	k_mutex_unlock(&infer_subscribers_lock);
+}
+
+void infer_service_unsubscribe(struct infer_subscriber *sub)
+{
+	k_mutex_lock(&infer_subscribers_lock, K_FOREVER);
+	sys_slist_find_and_remove(&infer_subscribers, &sub->node);
+	k_mutex_unlock(&infer_subscribers_lock);
+}
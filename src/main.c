@@ -10,8 +10,10 @@
 
 #include "key_mgmt.h"
 #include "infer_mgmt.h"
+#include "infer_service.h"
 #include "util_app_log.h"
 #include "dhcpwait.h"
+#include "provision.h"
 
 /** Declare a reference to the application logging interface. */
 LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
@@ -33,9 +35,17 @@ void main(void)
 	/* Initialise references to derived keys (required once before use!). */
 	km_keys_init();
 
+	/* Load provisioning data stored by an earlier bootstrap, if any. */
+	if (provision_init() == 0) {
+		LOG_INF("Device already provisioned");
+	}
+
 	/* Initialise references to the inference engine and models. */
 	infer_init();
 
+	/* Start the workers serving queued inference requests. */
+	infer_service_init();
+
 	/* Derive the device UUID, which will cache it for later requests. */
 	status = al_psa_status(km_get_uuid(uuid, sizeof(uuid)), __func__);
 	if (status != PSA_SUCCESS) {
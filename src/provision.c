@@ -7,159 +7,349 @@
 #include <zephyr/zephyr.h>
 #include <provision.h>
 #include <psa/protected_storage.h>
+#include <string.h>
+#include <nanocbor/nanocbor.h>
 
 /* Mutex/condition to coordinate device provisioning. */
 static K_MUTEX_DEFINE(prov_lock);
 static K_CONDVAR_DEFINE(prov_cond);
 
-/* The above protect this variable, which indicates that device provisioning has
- * completed.
- * TODO: This provisioning currently isn't tested (and certainly won't work)
- * reading the provisioned data on startup.  To implement this, we need to query
- * the items on first attemp, and read them from PS if possible.
+/* The above protect this variable, which indicates which provisioning data
+ * is present, and the cached copy of that data below.
  */
-
 static enum provision_present prov_present;
 
-int provision_store(const struct provision_data *prov)
+/* In-RAM copy of the provisioning data in persistent storage, so readers
+ * don't go back to protected storage.
+ */
+static uint8_t prov_tls_cert[PROVISION_CERT_MAX];
+static size_t prov_tls_cert_len;
+static char prov_hubname[PROVISION_HUBNAME_MAX + 1];
+static size_t prov_hubname_len;
+static uint16_t prov_hubport;
+
+/* Keys of the provisioning record, a CBOR map holding the fields present. */
+enum provision_key {
+	PROV_KEY_VERSION = 0,
+	PROV_KEY_TLS_CERT = 1,
+	PROV_KEY_HUBNAME = 2,
+	PROV_KEY_HUBPORT = 3,
+};
+
+/* Encoded provisioning record, as read from or written to storage. */
+static uint8_t prov_record[PROVISION_RECORD_MAX];
+
+/* Called with prov_lock held. */
+static int provision_decode(const uint8_t *buf, size_t len)
 {
-	psa_status_t pres;
-	int rc = -EINVAL;
+	struct nanocbor_value decode;
+	struct nanocbor_value map;
+	enum provision_present present = 0;
+	const uint8_t *str;
+	size_t str_len;
+	uint32_t key;
+	uint32_t value;
+	int res;
 
-	k_mutex_lock(&prov_lock, K_FOREVER);
+	nanocbor_decoder_init(&decode, buf, len);
 
-	if ((prov->present & PROVISION_TLS_CERT) != 0) {
-		pres = psa_ps_set(APP_PS_TLS_CERT, prov->tls_cert_der_len, prov->tls_cert_der,
-				  PSA_STORAGE_FLAG_NONE);
-		if (pres < 0) {
-			/* TODO: Better error code here? */
-			rc = -EINVAL;
-			goto unlock_out;
-		}
+	res = nanocbor_enter_map(&decode, &map);
+	if (res < 0) {
+		return -EINVAL;
+	}
 
-		prov_present |= PROVISION_TLS_CERT;
+	/* The version comes first, so an unknown layout is not decoded. */
+	if (nanocbor_get_uint32(&map, &key) < 0 || key != PROV_KEY_VERSION ||
+	    nanocbor_get_uint32(&map, &value) < 0 || value != PROVISION_RECORD_VERSION) {
+		return -EINVAL;
 	}
 
-	if ((prov->present & PROVISION_HUBNAME) != 0) {
-		pres = psa_ps_set(APP_PS_HUBNAME, prov->hubname_len, prov->hubname,
-				  PSA_STORAGE_FLAG_NONE);
-		if (pres < 0) {
-			/* TODO: Better error code here? */
-			rc = -EINVAL;
-			goto unlock_out;
+	while (!nanocbor_at_end(&map)) {
+		if (nanocbor_get_uint32(&map, &key) < 0) {
+			return -EINVAL;
+		}
+
+		switch (key) {
+		case PROV_KEY_TLS_CERT:
+			res = nanocbor_get_bstr(&map, &str, &str_len);
+			if (res < 0 || str_len > sizeof(prov_tls_cert)) {
+				return -EINVAL;
+			}
+			memcpy(prov_tls_cert, str, str_len);
+			prov_tls_cert_len = str_len;
+			present |= PROVISION_TLS_CERT;
+			break;
+		case PROV_KEY_HUBNAME:
+			res = nanocbor_get_tstr(&map, &str, &str_len);
+			if (res < 0 || str_len > PROVISION_HUBNAME_MAX) {
+				return -EINVAL;
+			}
+			memcpy(prov_hubname, str, str_len);
+			prov_hubname[str_len] = '\0';
+			prov_hubname_len = str_len;
+			present |= PROVISION_HUBNAME;
+			break;
+		case PROV_KEY_HUBPORT:
+			res = nanocbor_get_uint32(&map, &value);
+			if (res < 0 || value > UINT16_MAX) {
+				return -EINVAL;
+			}
+			prov_hubport = value;
+			present |= PROVISION_HUBPORT;
+			break;
+		default:
+			/* Fields from a later revision of this version. */
+			if (nanocbor_skip(&map) < 0) {
+				return -EINVAL;
+			}
+			break;
 		}
+	}
+
+	prov_present |= present;
+	return 0;
+}
+
+/* Called with prov_lock held.  Read the objects each field was stored in
+ * before the provisioning record.
+ */
+static void provision_load_legacy(void)
+{
+	psa_status_t pres;
+	size_t out_len;
 
+	pres = psa_ps_get(APP_PS_TLS_CERT, 0, sizeof(prov_tls_cert), prov_tls_cert, &out_len);
+	if (pres == PSA_SUCCESS) {
+		prov_tls_cert_len = out_len;
+		prov_present |= PROVISION_TLS_CERT;
+	}
+
+	pres = psa_ps_get(APP_PS_HUBNAME, 0, PROVISION_HUBNAME_MAX, prov_hubname, &out_len);
+	if (pres == PSA_SUCCESS) {
+		prov_hubname[out_len] = '\0';
+		prov_hubname_len = out_len;
 		prov_present |= PROVISION_HUBNAME;
 	}
 
-	if ((prov->present & PROVISION_HUBPORT) != 0) {
-		pres = psa_ps_set(APP_PS_HUBPORT, sizeof(uint16_t), &prov->hubport,
-				  PSA_STORAGE_FLAG_NONE);
-		if (pres < 0) {
-			/* TODO: Better error code here? */
-			rc = -EINVAL;
-			goto unlock_out;
+	pres = psa_ps_get(APP_PS_HUBPORT, 0, sizeof(prov_hubport), &prov_hubport, &out_len);
+	if (pres == PSA_SUCCESS && out_len == sizeof(prov_hubport)) {
+		prov_present |= PROVISION_HUBPORT;
+	}
+}
+
+/* Called with prov_lock held.  Encode the cached fields, with those in
+ * @prov taking their place, into prov_record.
+ */
+static int provision_encode(const struct provision_data *prov,
+			    enum provision_present present, size_t *len)
+{
+	nanocbor_encoder_t enc;
+	char hubname[PROVISION_HUBNAME_MAX + 1];
+	size_t count = 1;
+
+	for (enum provision_present bit = PROVISION_TLS_CERT; bit <= PROVISION_HUBPORT;
+	     bit <<= 1) {
+		count += (present & bit) != 0;
+	}
+
+	nanocbor_encoder_init(&enc, prov_record, sizeof(prov_record));
+	nanocbor_fmt_map(&enc, count);
+	nanocbor_fmt_uint(&enc, PROV_KEY_VERSION);
+	nanocbor_fmt_uint(&enc, PROVISION_RECORD_VERSION);
+
+	if ((prov->present & PROVISION_TLS_CERT) != 0) {
+		nanocbor_fmt_uint(&enc, PROV_KEY_TLS_CERT);
+		nanocbor_put_bstr(&enc, prov->tls_cert_der, prov->tls_cert_der_len);
+	} else if ((present & PROVISION_TLS_CERT) != 0) {
+		nanocbor_fmt_uint(&enc, PROV_KEY_TLS_CERT);
+		nanocbor_put_bstr(&enc, prov_tls_cert, prov_tls_cert_len);
+	}
+
+	if ((present & PROVISION_HUBNAME) != 0) {
+		/* CBOR fetched names are not terminated. */
+		if ((prov->present & PROVISION_HUBNAME) != 0) {
+			memcpy(hubname, prov->hubname, prov->hubname_len);
+			hubname[prov->hubname_len] = '\0';
+		} else {
+			memcpy(hubname, prov_hubname, prov_hubname_len + 1);
 		}
+		nanocbor_fmt_uint(&enc, PROV_KEY_HUBNAME);
+		nanocbor_put_tstr(&enc, hubname);
+	}
 
-		prov_present |= PROVISION_HUBPORT;
+	if ((present & PROVISION_HUBPORT) != 0) {
+		nanocbor_fmt_uint(&enc, PROV_KEY_HUBPORT);
+		nanocbor_fmt_uint(&enc, (prov->present & PROVISION_HUBPORT) != 0 ?
+				  prov->hubport : prov_hubport);
+	}
+
+	*len = nanocbor_encoded_len(&enc);
+	if (*len > sizeof(prov_record)) {
+		return -ENOSPC;
 	}
 
+	return 0;
+}
+
+/* Called with prov_lock held.  The whole record is rewritten in one go, so
+ * a power failure leaves either the old or the new record, never a mix of
+ * both.
+ */
+static int provision_write(const struct provision_data *prov,
+			   enum provision_present present)
+{
+	psa_status_t pres;
+	size_t len;
+	int rc;
+
+	rc = provision_encode(prov, present, &len);
+	if (rc != 0) {
+		return rc;
+	}
+
+	pres = psa_ps_set(APP_PS_PROVISION, len, prov_record, PSA_STORAGE_FLAG_NONE);
+	if (pres < 0) {
+		/* TODO: Better error code here? */
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int provision_store(const struct provision_data *prov)
+{
+	enum provision_present present;
+	int rc;
+
+	k_mutex_lock(&prov_lock, K_FOREVER);
+
+	if (((prov->present & PROVISION_TLS_CERT) != 0 &&
+	     prov->tls_cert_der_len > sizeof(prov_tls_cert)) ||
+	    ((prov->present & PROVISION_HUBNAME) != 0 &&
+	     prov->hubname_len > PROVISION_HUBNAME_MAX)) {
+		rc = -ENOSPC;
+		goto unlock_out;
+	}
+
+	present = (prov_present | prov->present) & PROV_MASK_TLS;
+	rc = provision_write(prov, present);
+	if (rc != 0) {
+		goto unlock_out;
+	}
+
+	/* Stored, the cache can follow. */
+	if ((prov->present & PROVISION_TLS_CERT) != 0) {
+		memcpy(prov_tls_cert, prov->tls_cert_der, prov->tls_cert_der_len);
+		prov_tls_cert_len = prov->tls_cert_der_len;
+	}
+
+	if ((prov->present & PROVISION_HUBNAME) != 0) {
+		memcpy(prov_hubname, prov->hubname, prov->hubname_len);
+		prov_hubname[prov->hubname_len] = '\0';
+		prov_hubname_len = prov->hubname_len;
+	}
+
+	if ((prov->present & PROVISION_HUBPORT) != 0) {
+		prov_hubport = prov->hubport;
+	}
+
+	prov_present |= present;
+
 	/* After writing everything out, we are considered provisioned, so we can tell everyone. */
 	k_condvar_broadcast(&prov_cond);
 
 unlock_out:
 	k_mutex_unlock(&prov_lock);
-	return 0;
+	return rc;
 }
 
-int provision_wait(enum provision_present mask)
+/* Called with prov_lock held.  Before the provisioning record, each field
+ * was stored in its own object.  Move those into the record.
+ */
+static void provision_migrate(void)
+{
+	static const struct provision_data none;
+
+	provision_load_legacy();
+	if (prov_present == 0) {
+		return;
+	}
+
+	if (provision_write(&none, prov_present & PROV_MASK_TLS) == 0) {
+		psa_ps_remove(APP_PS_TLS_CERT);
+		psa_ps_remove(APP_PS_HUBNAME);
+		psa_ps_remove(APP_PS_HUBPORT);
+	}
+}
+
+int provision_init(void)
 {
+	psa_status_t pres;
+	size_t out_len;
+
 	k_mutex_lock(&prov_lock, K_FOREVER);
-	while ((prov_present & mask) != mask) {
-		k_condvar_wait(&prov_cond, &prov_lock, K_FOREVER);
+
+	/* One read brings in everything stored. */
+	pres = psa_ps_get(APP_PS_PROVISION, 0, sizeof(prov_record), prov_record, &out_len);
+	if (pres == PSA_SUCCESS) {
+		if (provision_decode(prov_record, out_len) < 0) {
+			/* Partly decoded data is not to be trusted. */
+			prov_present = 0;
+		}
+	} else if (pres == PSA_ERROR_DOES_NOT_EXIST) {
+		provision_migrate();
 	}
+
+	/* A device provisioned before the reboot can go ahead right away. */
+	if (prov_present != 0) {
+		k_condvar_broadcast(&prov_cond);
+	}
+
 	k_mutex_unlock(&prov_lock);
-	return 0;
+
+	return (prov_present & PROV_MASK_TLS) == PROV_MASK_TLS ? 0 : -ENOENT;
 }
 
-/**
- * @brief Map the return result from #psa_ps_get to an RC code.
- *
- * @param pres the status from the #psa_ps_get call.
- * @return int Either 0, or a negative errno-type error.
- */
-static int map_psa_ps_error(psa_status_t pres)
+int provision_wait(enum provision_present mask)
 {
-	switch (pres) {
-	case PSA_ERROR_INVALID_ARGUMENT:
-		return -ENOMEM;
-	case PSA_ERROR_DOES_NOT_EXIST:
-		return -ENOENT;
-	case PSA_SUCCESS:
-		return 0;
-	default:
-		return -EINVAL;
+	k_mutex_lock(&prov_lock, K_FOREVER);
+	while ((prov_present & mask) != mask) {
+		k_condvar_wait(&prov_cond, &prov_lock, K_FOREVER);
 	}
+	k_mutex_unlock(&prov_lock);
+	return 0;
 }
 
 int provision_get(struct provision_data *prov, char *buf, size_t buf_len)
 {
-	int rc = 0;
-	size_t total_len = 0;
-	size_t out_len;
-	psa_status_t pres;
+	int rc;
 
 	k_mutex_lock(&prov_lock, K_FOREVER);
-	if (prov_present != ALL_PROVISION_DATA) {
+	if ((prov_present & PROV_MASK_TLS) != PROV_MASK_TLS) {
 		rc = -ENOENT;
 		goto out;
 	}
 
-	/* Retrieve the TLS certificate. */
-	pres = psa_ps_get(APP_PS_TLS_CERT, 0, buf_len, buf, &out_len);
-	rc = map_psa_ps_error(pres);
-	if (rc != 0) {
-		goto out;
-	}
-	prov->tls_cert_der = buf;
-	prov->tls_cert_der_len = out_len;
-	total_len += out_len;
-	buf += out_len;
-	buf_len -= out_len;
-
-	/* Ensure we have enough space for a possible hubname, and a null
-	 * termination. */
-	if (buf_len < 2) {
+	/* Room for the certificate, and the hubname with its terminating
+	 * null. */
+	if (buf_len < prov_tls_cert_len + prov_hubname_len + 1) {
 		rc = -ENOSPC;
 		goto out;
 	}
 
-	/* Retrieve the hubname.  We use buf_len-1 to allow space for the
-	 * terminating null on the string. */
-	pres = psa_ps_get(APP_PS_HUBNAME, 0, buf_len, buf, &out_len);
-	rc = map_psa_ps_error(pres);
-	if (rc != 0) {
-		goto out;
-	}
+	memcpy(buf, prov_tls_cert, prov_tls_cert_len);
+	prov->tls_cert_der = buf;
+	prov->tls_cert_der_len = prov_tls_cert_len;
+	buf += prov_tls_cert_len;
+
+	memcpy(buf, prov_hubname, prov_hubname_len + 1);
 	prov->hubname = buf;
-	prov->hubname_len = out_len;
-	total_len += out_len + 1;
-	buf += out_len;
-	*(buf++) = '\0';
-	buf_len -= out_len + 1;
-
-	/* Retrieve the port. */
-	pres = psa_ps_get(APP_PS_HUBPORT, 0, sizeof(uint16_t), &prov->hubport, &out_len);
-	rc = map_psa_ps_error(pres);
-	if (rc != 0) {
-		goto out;
-	}
-	if (out_len != sizeof(uint16_t)) {
-		rc = -EINVAL;
-		goto out;
-	}
+	prov->hubname_len = prov_hubname_len;
+
+	prov->hubport = prov_hubport;
+	prov->present = prov_present & PROV_MASK_TLS;
 
-	rc = total_len;
+	rc = prov_tls_cert_len + prov_hubname_len + 1;
 out:
 	k_mutex_unlock(&prov_lock);
 	return rc;
@@ -11,6 +11,7 @@
 #include "cose/cose_verify.h"
 #include "cose/mbedtls_ecdsa_verify_sign.h"
 #include "infer_mgmt.h"
+#include "infer_service.h"
 #include "tfm_partition_huk.h"
 #include "tfm_partition_tflm.h"
 #include "util_app_log.h"
@@ -23,6 +24,12 @@ LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
 
 #if CONFIG_SECURE_INFER_SHELL_CMD_SUPPORT
 
+/* Output representation requested by 'infer get', see 'infer output'. */
+static infer_out_t infer_out_fmt = INFER_OUT_FLOAT;
+
+/* Shell the results of 'infer submit' are printed to. */
+static const struct shell *infer_submit_shell;
+
 static int
 cmd_infer_list_models(const struct shell *shell, size_t argc, char **argv)
 {
@@ -63,13 +70,6 @@ cmd_infer_get_sine_val(const struct shell *shell,
 	char *payload_format[3] = { "CBOR", "SIGN1", "ENCRYPT0" };
 	_Bool is_valid_payload_format = false;
 
-#if CONFIG_NONSECURE_COSE_VERIFY_SIGN
-	uint8_t key_ctx_idx = KEY_C_SIGN;
-	uint8_t pubkey[KM_PUBLIC_KEY_SIZE] = { 0 };
-	size_t pubkey_len = sizeof(pubkey);
-
-#endif
-
 	if ((argc == 1) || (strcmp(argv[1], "help") == 0)) {
 		shell_print(shell, "Requests a new sine wave approximation using TFLM.\n");
 		shell_print(shell, "  $ %s %s %s <format> <start> <[stop] [stride]>\n",
@@ -151,6 +151,7 @@ cmd_infer_get_sine_val(const struct shell *shell,
 		usr_in_val_deg = usr_in_val_start * deg;
 		status =  cose_output(
 			enc_fmt,
+			infer_out_fmt,
 			model,
 			(void *)&usr_in_val_deg,
 			sizeof(usr_in_val_deg),
@@ -170,18 +171,9 @@ cmd_infer_get_sine_val(const struct shell *shell,
 
 #if CONFIG_NONSECURE_COSE_VERIFY_SIGN
 		if (enc_fmt == INFER_ENC_COSE_SIGN1) {
-			status = km_get_pubkey(pubkey, pubkey_len,
-					       key_ctx_idx);
-
-			if (status != 0) {
-				return shell_com_rc_code(shell,
-							 "Failed to get the public key",
-							 status);
-			}
 			status = infer_verify_signature(infval_enc_buf,
 							infval_enc_buf_len,
-							pubkey,
-							pubkey_len,
+							KEY_COSE,
 							&model_out_val);
 			if (status != 0) {
 				return shell_com_rc_code(shell,
@@ -262,6 +254,255 @@ cmd_infer_get(const struct shell *shell, size_t argc, char **argv)
 	return 0;
 }
 
+static int
+cmd_infer_warmup(const struct shell *shell, size_t argc, char **argv)
+{
+	psa_status_t status;
+
+	status = infer_tflm_warmup("TFLM_MODEL_SINE");
+	if (status != PSA_SUCCESS) {
+		return shell_com_rc_code(shell,
+					 "Model warm-up failed with ",
+					 status);
+	}
+
+	shell_print(shell, "TFLM_MODEL_SINE initialised");
+
+	return 0;
+}
+
+static int
+cmd_infer_output(const struct shell *shell, size_t argc, char **argv)
+{
+	char *out_format[INFER_OUT_NONE] = { "float", "int8" };
+
+	if ((argc == 1) || (strcmp(argv[1], "help") == 0)) {
+		shell_print(shell, "Selects the inference output representation.\n");
+		shell_print(shell, "  $ %s %s <output>\n", argv[-1], argv[0]);
+		shell_print(shell,
+			    "  <output>   Dequantized values (float) or raw quantized tensor (int8)");
+		shell_print(shell, "Current: %s", out_format[infer_out_fmt]);
+		return 0;
+	}
+
+	for (int i = 0; i < INFER_OUT_NONE; i++) {
+		if (strcmp(argv[1], out_format[i]) == 0) {
+			infer_out_fmt = i;
+			shell_print(shell, "Inference output: %s", out_format[i]);
+			return 0;
+		}
+	}
+
+	return shell_com_invalid_arg(shell, argv[1]);
+}
+
+static void
+cmd_infer_submit_result(const infer_result_t *res, void *user_data)
+{
+	const struct shell *shell = infer_submit_shell;
+
+	ARG_UNUSED(user_data);
+
+	/* Only print the results of requests queued from the shell */
+	if (res->req->tag != &infer_submit_shell || shell == NULL) {
+		return;
+	}
+
+	if (res->status != PSA_SUCCESS) {
+		shell_error(shell, "Queued inference failed: %d", res->status);
+		return;
+	}
+
+	shell_print(shell, "Queued inference of %.2f rad:", res->req->input);
+	shell_hexdump(shell, res->buf, res->len);
+}
+
+static struct infer_subscriber infer_submit_sub = {
+	.cb = cmd_infer_submit_result,
+};
+
+static int
+cmd_infer_submit(const struct shell *shell, size_t argc, char **argv)
+{
+	const float PI = 3.14159265359f;
+	char *models[INFER_MODEL_COUNT] = { "tflm_sine", "utvm_sine" };
+	char *payload_format[3] = { "CBOR", "SIGN1", "ENCRYPT0" };
+	infer_request_t req = {
+		.model = INFER_MODEL_COUNT,
+		.enc_format = INFER_ENC_NONE,
+		.out_format = infer_out_fmt,
+		.prio = INFER_PRIO_INTERACTIVE,
+		.tag = &infer_submit_shell,
+	};
+	float usr_in_val;
+	int rc;
+
+	if ((argc == 1) || (strcmp(argv[1], "help") == 0)) {
+		shell_print(shell, "Queues an inference request to the inference workers.\n");
+		shell_print(shell, "  $ %s %s <model> <format> <input> [background]\n",
+			    argv[-1], argv[0]);
+		shell_print(shell, "  <model>      tflm_sine or utvm_sine");
+		shell_print(shell, "  <format>     Payload format (CBOR, SIGN1, ENCRYPT0)");
+		shell_print(shell, "  <input>      Inference input 0 to 359");
+		shell_print(shell, "  [background] Optional: Queue behind interactive requests\n");
+		shell_print(shell, "Example: $ %s %s tflm_sine SIGN1 90", argv[-1], argv[0]);
+		return 0;
+	}
+
+	for (int i = 0; i < INFER_MODEL_COUNT; i++) {
+		if (strcmp(argv[1], models[i]) == 0) {
+			req.model = i;
+		}
+	}
+	if (req.model == INFER_MODEL_COUNT) {
+		return shell_com_invalid_arg(shell, argv[1]);
+	}
+
+	if (argc == 2) {
+		return shell_com_missing_arg(shell, "format");
+	}
+
+	for (int i = 0; i < INFER_ENC_NONE; i++) {
+		if (strcmp(argv[2], payload_format[i]) == 0) {
+			req.enc_format = i;
+		}
+	}
+	if (req.enc_format == INFER_ENC_NONE) {
+		return shell_com_invalid_arg(shell, argv[2]);
+	}
+
+	if (argc == 3) {
+		return shell_com_missing_arg(shell, "input");
+	}
+
+	if (!shell_com_str_to_float_min_max(argv[3],
+					    &usr_in_val,
+					    SINE_INPUT_MIN,
+					    SINE_INPUT_MAX)) {
+		return shell_com_invalid_arg(shell, argv[3]);
+	}
+	req.input = usr_in_val * PI / 180.0f;
+
+	if (argc > 4) {
+		if (strcmp(argv[4], "background") != 0) {
+			return shell_com_invalid_arg(shell, argv[4]);
+		}
+		req.prio = INFER_PRIO_BACKGROUND;
+	}
+
+	if (infer_submit_shell == NULL) {
+		infer_submit_shell = shell;
+		infer_service_subscribe(&infer_submit_sub);
+	}
+
+	rc = infer_service_submit(&req, K_NO_WAIT);
+	if (rc) {
+		return shell_com_rc_code(shell, "Inference queue is full", rc);
+	}
+
+	shell_print(shell, "Inference request queued");
+
+	return 0;
+}
+
+#if CONFIG_NONSECURE_COSE_VERIFY_SIGN
+/* Largest number of outputs checked by a single 'infer verify'. */
+#define INFER_VERIFY_BATCH_MAX 8
+
+static int
+cmd_infer_verify(const struct shell *shell, size_t argc, char **argv)
+{
+	const float PI = 3.14159265359f;
+	char *models[INFER_MODEL_COUNT] = { "tflm_sine", "utvm_sine" };
+	char *model_ids[INFER_MODEL_COUNT] = { "TFLM_MODEL_SINE",
+					       "UTVM_MODEL_SINE" };
+	infer_get_cose_output cose_output[INFER_MODEL_COUNT] = {
+		infer_get_tflm_cose_output,
+		infer_get_utvm_cose_output,
+	};
+	static uint8_t bufs[INFER_VERIFY_BATCH_MAX][INFER_ENC_MAX_VALUE_SZ];
+	const uint8_t *objs[INFER_VERIFY_BATCH_MAX];
+	size_t lens[INFER_VERIFY_BATCH_MAX];
+	int results[INFER_VERIFY_BATCH_MAX];
+	int model = INFER_MODEL_COUNT;
+	float count_val, usr_in_val[INFER_VERIFY_BATCH_MAX], in_rad;
+	size_t count;
+	psa_status_t status;
+	int rc;
+
+	if ((argc == 1) || (strcmp(argv[1], "help") == 0)) {
+		shell_print(shell, "Runs a series of SIGN1 inferences and verifies them as one batch.\n");
+		shell_print(shell, "  $ %s %s <model> <count>\n", argv[-1], argv[0]);
+		shell_print(shell, "  <model>    tflm_sine or utvm_sine");
+		shell_print(shell, "  <count>    Number of inferences, 1 to %d, spread over 0 to 359 deg\n",
+			    INFER_VERIFY_BATCH_MAX);
+		shell_print(shell, "Example: $ %s %s tflm_sine 4", argv[-1], argv[0]);
+		return 0;
+	}
+
+	for (int i = 0; i < INFER_MODEL_COUNT; i++) {
+		if (strcmp(argv[1], models[i]) == 0) {
+			model = i;
+		}
+	}
+	if (model == INFER_MODEL_COUNT) {
+		return shell_com_invalid_arg(shell, argv[1]);
+	}
+
+	if (argc == 2) {
+		return shell_com_missing_arg(shell, "count");
+	}
+
+	if (!shell_com_str_to_float_min_max(argv[2],
+					    &count_val,
+					    1,
+					    INFER_VERIFY_BATCH_MAX) ||
+	    count_val != (size_t)count_val) {
+		return shell_com_invalid_arg(shell, argv[2]);
+	}
+	count = (size_t)count_val;
+
+	for (size_t i = 0; i < count; i++) {
+		usr_in_val[i] = (float)(i * (SINE_INPUT_MAX + 1)) / count;
+		in_rad = usr_in_val[i] * PI / 180.0f;
+		status = cose_output[model](INFER_ENC_COSE_SIGN1,
+					    infer_out_fmt,
+					    model_ids[model],
+					    (void *)&in_rad,
+					    sizeof(in_rad),
+					    bufs[i],
+					    sizeof(bufs[i]),
+					    &lens[i]);
+		if (status != 0) {
+			return shell_com_rc_code(shell,
+						 "Failed to get encoded inference output",
+						 status);
+		}
+		objs[i] = bufs[i];
+	}
+
+	rc = infer_verify_signature_batch(objs, lens, count, KEY_COSE, results);
+
+	for (size_t i = 0; i < count; i++) {
+		if (results[i] == COSE_ERROR_NONE) {
+			shell_print(shell, "%.2f deg: signature verified",
+				    usr_in_val[i]);
+		} else {
+			shell_print(shell, "%.2f deg: verification failed (%d)",
+				    usr_in_val[i], results[i]);
+		}
+	}
+
+	if (rc != COSE_ERROR_NONE) {
+		return shell_com_rc_code(shell,
+					 "Failed to verify the batch",
+					 rc);
+	}
+
+	return 0;
+}
+#endif /* CONFIG_NONSECURE_COSE_VERIFY_SIGN */
+
 static int
 cmd_infer_aat(const struct shell *shell, size_t argc, char **argv)
 {
@@ -303,6 +544,14 @@ SHELL_STATIC_SUBCMD_SET_CREATE(sub_cmd_infer,
 	SHELL_CMD_ARG(model, NULL, "List inference models", cmd_infer_list_models, 1, 0),
 	/* 'get' command handler. */
 	SHELL_CMD(get, &sub_cmd_model, "Run inference on given input(s)", cmd_infer_get),
+	/* 'warmup' command handler. */
+	SHELL_CMD_ARG(warmup, NULL, "Initialise the TFLM sine model ahead of use", cmd_infer_warmup, 1, 0),
+	/* 'submit' command handler. */
+	SHELL_CMD_ARG(submit, NULL, "$ infer submit <model> <format> <input> [background]", cmd_infer_submit, 1, 4),
+	/* 'output' command handler. */
+	SHELL_CMD_ARG(output, NULL, "$ infer output <float|int8>", cmd_infer_output, 1, 1),
+	/* 'verify' command handler. */
+	SHELL_COND_CMD_ARG(CONFIG_NONSECURE_COSE_VERIFY_SIGN, verify, NULL, "$ infer verify <model> <count>", cmd_infer_verify, 1, 2),
         /* 'token' command handler. */
 	SHELL_CMD_ARG(token, NULL, "Create Application Attestation Token(AAT)", cmd_infer_aat, 1, 0),
         /* Array terminator. */
@@ -212,15 +212,52 @@ cmd_keys_csr(const struct shell *shell, size_t argc, char **argv)
 }
 
 #ifdef CONFIG_APP_NETWORKING
+/* Request certificates for every key, and the service information, over
+ * one bootstrap connection. */
+static int
+cmd_keys_ca_all(const struct shell *shell)
+{
+	struct bootstrap bctx;
+
+	int status = bootstrap_open(&bctx);
+	if (status != 0) {
+		return shell_com_rc_code(shell,
+					 "Failed to talk to bootstrap server",
+					 status);
+	}
+
+	/* Request is static to prevent stack overflow. */
+	static struct csr_batch_req req;
+	status = bootstrap_csr_all(&bctx, &req);
+	if (status != 0) {
+		shell_com_rc_code(shell, "Unable to process CSRs", status);
+	} else {
+		status = bootstrap_service(&bctx);
+		if (status != 0) {
+			shell_com_rc_code(shell,
+					  "Unable to request service information",
+					  status);
+		}
+	}
+
+	int status2 = bootstrap_close(&bctx);
+	if (status2 != 0) {
+		shell_print(shell, "Error: Error closing bootstrap connection: %d", status2);
+	}
+
+	return status;
+}
+
 static int
 cmd_keys_ca(const struct shell *shell, size_t argc, char **argv)
 {
 	shell_print(shell, "argc: %d", argc);
 	if (argc < 2 || strcmp(argv[1], "help") == 0) {
 		shell_print(shell, "Request certificate from bootstrap server for the given key\n");
-		shell_print(shell, "$ %s %s ca <Key ID>\n", argv[-1], argv[0]);
+		shell_print(shell, "$ %s %s ca <Key ID|all>\n", argv[-1], argv[0]);
 		shell_print(shell, "Run 'status' for key ID list\n");
 		shell_print(shell, "Example: $ %s %s 5001", argv[-1], argv[0]);
+		shell_print(shell, "Example: $ %s %s all", argv[-1], argv[0]);
 		return 0;
 	}
 
@@ -228,6 +265,10 @@ cmd_keys_ca(const struct shell *shell, size_t argc, char **argv)
 		return shell_com_invalid_arg(shell, argv[2]);
 	}
 
+	if (strcmp(argv[1], "all") == 0) {
+		return cmd_keys_ca_all(shell);
+	}
+
 	/* Validate the Key ID. */
 	uint32_t key_id = strtoul(argv[1], NULL, 16);
 	uint8_t key_idx;
@@ -305,7 +346,7 @@ SHELL_STATIC_SUBCMD_SET_CREATE(sub_cmd_keys,
 	SHELL_CMD(csr, NULL, "Generate and display CSR on given key ID", cmd_keys_csr),
 #ifdef CONFIG_APP_NETWORKING
 	/* 'CA' command handler. */
-	SHELL_CMD(ca, NULL, "Request certificate from CA", cmd_keys_ca),
+	SHELL_CMD(ca, NULL, "Request certificate(s) from CA", cmd_keys_ca),
 #endif
 	/* Array terminator. */
 	SHELL_SUBCMD_SET_END
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/zephyr.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <string.h>
+#include <nanocbor/nanocbor.h>
+
+#include "azure-config.h"
+#include "infer_service.h"
+#include "telemetry.h"
+
+/** Declare a reference to the application logging interface. */
+LOG_MODULE_DECLARE(app, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* Room kept in the MQTT buffers for the PUBLISH header and event topic. */
+#define TELEMETRY_MQTT_OVERHEAD 128
+
+/* Largest CBOR array header, written in front of the results on take. */
+#define TELEMETRY_ARRAY_HDR_MAX 3
+
+#define TELEMETRY_BATCH_SIZE    (APP_MQTT_BUFFER_SIZE - TELEMETRY_MQTT_OVERHEAD)
+
+/* A batch of COSE_Sign1 results, encoded in place by the inference workers
+ * and handed to MQTT as is. The results are appended after room for the
+ * array header, which is only known once the batch is taken.
+ *
+ * References are held by the batch while it is being filled, by the
+ * inference request encoding into it, and by MQTT until the PUBACK.
+ */
+struct telemetry_payload {
+	uint8_t buf[TELEMETRY_BATCH_SIZE];
+	size_t len;             /* Bytes used, header room included */
+	size_t count;           /* Results in the batch */
+	bool full;              /* No room for another result */
+	atomic_t ref;
+};
+
+static struct telemetry_payload telemetry_pool[CONFIG_AZURE_TELEMETRY_BUFFERS];
+
+/* Batch being filled, NULL when the pool was empty. */
+static struct telemetry_payload *telemetry_fill;
+/* An inference request is encoding into telemetry_fill. */
+static bool telemetry_pending;
+static K_MUTEX_DEFINE(telemetry_lock);
+
+static telemetry_ready_cb_t telemetry_ready;
+static uint32_t telemetry_dropped;
+
+static struct k_work_delayable telemetry_produce;
+static bool telemetry_running;
+
+/* Input of the next request, sweeping the range of the sine models. */
+static float telemetry_input;
+
+static struct telemetry_payload *telemetry_alloc(void)
+{
+	for (int i = 0; i < CONFIG_AZURE_TELEMETRY_BUFFERS; i++) {
+		if (atomic_cas(&telemetry_pool[i].ref, 0, 1)) {
+			telemetry_pool[i].len = TELEMETRY_ARRAY_HDR_MAX;
+			telemetry_pool[i].count = 0;
+			telemetry_pool[i].full = false;
+			return &telemetry_pool[i];
+		}
+	}
+
+	return NULL;
+}
+
+void telemetry_release(struct telemetry_payload *payload)
+{
+	atomic_dec(&payload->ref);
+}
+
+static void telemetry_result(const infer_result_t *res, void *user_data)
+{
+	struct telemetry_payload *payload = res->req->tag;
+	bool full = false;
+	bool first = false;
+
+	ARG_UNUSED(user_data);
+
+	if (payload < &telemetry_pool[0] ||
+	    payload >= &telemetry_pool[CONFIG_AZURE_TELEMETRY_BUFFERS]) {
+		return;
+	}
+
+	k_mutex_lock(&telemetry_lock, K_FOREVER);
+	telemetry_pending = false;
+	if (payload != telemetry_fill) {
+		/* Taken while encoding, the result lies past the published
+		 * bytes and is dropped.
+		 */
+		telemetry_dropped++;
+	} else if (res->status != PSA_SUCCESS) {
+		/* Most likely out of room, publish what is there */
+		full = payload->count > 0;
+		payload->full = full;
+	} else {
+		payload->len += res->len;
+		first = (payload->count++ == 0);
+		/* Flush once another result of the same size would not fit */
+		full = payload->len + res->len > sizeof(payload->buf);
+		payload->full = full;
+	}
+	k_mutex_unlock(&telemetry_lock);
+
+	telemetry_release(payload);
+
+	if (telemetry_ready != NULL && (full || first)) {
+		telemetry_ready(full);
+	}
+}
+
+static struct infer_subscriber telemetry_sub = {
+	.cb = telemetry_result,
+};
+
+static void telemetry_produce_fn(struct k_work *work)
+{
+	const float PI = 3.14159265359f;
+	infer_request_t req = {
+		.model = INFER_MODEL_TFLM_SINE,
+		.enc_format = INFER_ENC_COSE_SIGN1,
+		.out_format = INFER_OUT_FLOAT,
+		.prio = INFER_PRIO_BACKGROUND,
+	};
+	struct telemetry_payload *payload;
+
+	if (!telemetry_running) {
+		return;
+	}
+
+	k_mutex_lock(&telemetry_lock, K_FOREVER);
+	if (telemetry_fill == NULL) {
+		telemetry_fill = telemetry_alloc();
+	}
+	payload = telemetry_fill;
+	if (payload == NULL || payload->full || telemetry_pending) {
+		/* Every buffer is waiting for a PUBACK, or this one for
+		 * its previous result. Skip the sample rather than queue
+		 * more work than the link can take.
+		 */
+		k_mutex_unlock(&telemetry_lock);
+		LOG_DBG("Telemetry buffers busy, skipping sample");
+		goto end;
+	}
+
+	/* The request encodes right after the last result */
+	atomic_inc(&payload->ref);
+	telemetry_pending = true;
+	req.tag = payload;
+	req.out = &payload->buf[payload->len];
+	req.out_size = sizeof(payload->buf) - payload->len;
+	k_mutex_unlock(&telemetry_lock);
+
+	req.input = telemetry_input;
+	telemetry_input += PI / 18.0f;
+	if (telemetry_input > 2.0f * PI) {
+		telemetry_input = 0.0f;
+	}
+
+	if (infer_service_submit(&req, K_NO_WAIT) != 0) {
+		LOG_DBG("Inference queue full, skipping telemetry sample");
+		k_mutex_lock(&telemetry_lock, K_FOREVER);
+		telemetry_pending = false;
+		k_mutex_unlock(&telemetry_lock);
+		telemetry_release(payload);
+	}
+
+end:
+	k_work_reschedule(&telemetry_produce,
+			  K_MSEC(CONFIG_AZURE_TELEMETRY_INTERVAL_MS));
+}
+
+void telemetry_start(telemetry_ready_cb_t ready)
+{
+	if (telemetry_running) {
+		return;
+	}
+
+	if (telemetry_ready == NULL) {
+		k_work_init_delayable(&telemetry_produce, telemetry_produce_fn);
+		infer_service_subscribe(&telemetry_sub);
+	}
+
+	telemetry_ready = ready;
+	telemetry_running = true;
+	k_work_reschedule(&telemetry_produce, K_NO_WAIT);
+}
+
+void telemetry_stop(void)
+{
+	telemetry_running = false;
+}
+
+struct telemetry_payload *telemetry_take(const uint8_t **data, size_t *len)
+{
+	struct telemetry_payload *payload;
+	nanocbor_encoder_t enc;
+	uint8_t hdr[TELEMETRY_ARRAY_HDR_MAX];
+	size_t hdr_len;
+
+	k_mutex_lock(&telemetry_lock, K_FOREVER);
+	payload = telemetry_fill;
+	if (payload == NULL || payload->count == 0) {
+		k_mutex_unlock(&telemetry_lock);
+		return NULL;
+	}
+	/* The batch reference moves to the caller */
+	telemetry_fill = NULL;
+	if (telemetry_dropped) {
+		LOG_WRN("Dropped %u telemetry results", telemetry_dropped);
+		telemetry_dropped = 0;
+	}
+	k_mutex_unlock(&telemetry_lock);
+
+	/* Put the array header right in front of the first result, so the
+	 * batch is published without another copy.
+	 */
+	nanocbor_encoder_init(&enc, hdr, sizeof(hdr));
+	nanocbor_fmt_array(&enc, payload->count);
+	hdr_len = nanocbor_encoded_len(&enc);
+	memcpy(&payload->buf[TELEMETRY_ARRAY_HDR_MAX - hdr_len], hdr, hdr_len);
+
+	*data = &payload->buf[TELEMETRY_ARRAY_HDR_MAX - hdr_len];
+	*len = payload->len - (TELEMETRY_ARRAY_HDR_MAX - hdr_len);
+
+	return payload;
+}
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <string.h>
 #include <tfm_veneers.h>
 #include <tfm_ns_interface.h>
 
@@ -33,7 +34,8 @@
 //      return status;
 // }
 
-psa_status_t psa_si_tflm_hello(infer_config_t *infer_config,
+psa_status_t psa_si_tflm_hello(psa_handle_t handle,
+			       infer_config_t *infer_config,
 			       void *input,
 			       size_t input_data_size,
 			       uint8_t *encoded_buf,
@@ -41,7 +43,6 @@ psa_status_t psa_si_tflm_hello(infer_config_t *infer_config,
 			       size_t *encoded_buf_len)
 {
 	psa_status_t status;
-	psa_handle_t handle;
 	psa_invec in_vec[] = {
 		{ .base = input, .len =  input_data_size },
 		{ .base = infer_config, .len = sizeof(infer_config_t) },
@@ -52,11 +53,72 @@ psa_status_t psa_si_tflm_hello(infer_config_t *infer_config,
 		{ .base = encoded_buf_len, .len = sizeof(size_t) },
 	};
 
-	handle = psa_connect(TFM_TFLM_SERVICE_HELLO_SID,
-			     TFM_TFLM_SERVICE_HELLO_VERSION);
-	if (!PSA_HANDLE_IS_VALID(handle)) {
-		return PSA_HANDLE_TO_ERROR(handle);
-	}
+	status = psa_call(handle,
+			  PSA_IPC_CALL,
+			  in_vec,
+			  IOVEC_LEN(in_vec),
+			  out_vec,
+			  IOVEC_LEN(out_vec));
+
+	return status;
+}
+
+psa_status_t psa_si_tflm_warmup(psa_handle_t handle, const char *model)
+{
+	psa_status_t status;
+	psa_invec in_vec[] = {
+		{ .base = model, .len = strlen(model) },
+	};
+
+	status = psa_call(handle,
+			  PSA_IPC_CALL,
+			  in_vec,
+			  IOVEC_LEN(in_vec),
+			  NULL,
+			  0);
+
+	return status;
+}
+
+psa_status_t psa_si_tflm_input_upload(psa_handle_t handle,
+				      const tflm_input_chunk_t *chunk,
+				      const float *data,
+				      size_t count)
+{
+	psa_status_t status;
+	psa_invec in_vec[] = {
+		{ .base = chunk, .len = sizeof(tflm_input_chunk_t) },
+		{ .base = data, .len = count * sizeof(float) },
+	};
+
+	status = psa_call(handle,
+			  PSA_IPC_CALL,
+			  in_vec,
+			  IOVEC_LEN(in_vec),
+			  NULL,
+			  0);
+
+	return status;
+}
+
+psa_status_t psa_si_tflm_hello_slot(psa_handle_t handle,
+				    infer_config_t *infer_config,
+				    uint32_t slot,
+				    uint8_t *encoded_buf,
+				    size_t infval_enc_buf_size,
+				    size_t *encoded_buf_len)
+{
+	psa_status_t status;
+	psa_invec in_vec[] = {
+		{ .base = NULL, .len = 0 },
+		{ .base = infer_config, .len = sizeof(infer_config_t) },
+		{ .base = &slot, .len = sizeof(slot) },
+	};
+
+	psa_outvec out_vec[] = {
+		{ .base = encoded_buf, .len = infval_enc_buf_size },
+		{ .base = encoded_buf_len, .len = sizeof(size_t) },
+	};
 
 	status = psa_call(handle,
 			  PSA_IPC_CALL,
@@ -65,7 +127,34 @@ psa_status_t psa_si_tflm_hello(infer_config_t *infer_config,
 			  out_vec,
 			  IOVEC_LEN(out_vec));
 
-	psa_close(handle);
+	return status;
+}
+
+psa_status_t psa_si_tflm_stream(psa_handle_t handle,
+				const tflm_stream_req_t *req,
+				const float *samples,
+				size_t count,
+				uint8_t *encoded_buf,
+				size_t infval_enc_buf_size,
+				size_t *encoded_buf_len)
+{
+	psa_status_t status;
+	psa_invec in_vec[] = {
+		{ .base = req, .len = sizeof(tflm_stream_req_t) },
+		{ .base = samples, .len = count * sizeof(float) },
+	};
+
+	psa_outvec out_vec[] = {
+		{ .base = encoded_buf, .len = infval_enc_buf_size },
+		{ .base = encoded_buf_len, .len = sizeof(size_t) },
+	};
+
+	status = psa_call(handle,
+			  PSA_IPC_CALL,
+			  in_vec,
+			  IOVEC_LEN(in_vec),
+			  out_vec,
+			  encoded_buf ? IOVEC_LEN(out_vec) : 0);
 
 	return status;
 }
@@ -11,7 +11,8 @@
 #include "psa/client.h"
 #include "psa_manifest/sid.h"
 
-psa_status_t psa_si_utvm(infer_config_t *infer_config,
+psa_status_t psa_si_utvm(psa_handle_t handle,
+			 infer_config_t *infer_config,
 			 void *input,
 			 size_t input_data_size,
 			 uint8_t *encoded_buf,
@@ -19,7 +20,6 @@ psa_status_t psa_si_utvm(infer_config_t *infer_config,
 			 size_t *encoded_buf_len)
 {
 	psa_status_t status;
-	psa_handle_t handle;
 	psa_invec in_vec[] = {
 		{ .base = input, .len =  input_data_size },
 		{ .base = infer_config, .len = sizeof(infer_config_t) },
@@ -30,12 +30,6 @@ psa_status_t psa_si_utvm(infer_config_t *infer_config,
 		{ .base = encoded_buf_len, .len = sizeof(size_t) },
 	};
 
-	handle = psa_connect(TFM_UTVM_SINE_MODEL_SERVICE_SID,
-			     TFM_UTVM_SINE_MODEL_SERVICE_VERSION);
-	if (!PSA_HANDLE_IS_VALID(handle)) {
-		return PSA_HANDLE_TO_ERROR(handle);
-	}
-
 	status = psa_call(handle,
 			  PSA_IPC_CALL,
 			  in_vec,
@@ -43,7 +37,5 @@ psa_status_t psa_si_utvm(infer_config_t *infer_config,
 			  out_vec,
 			  IOVEC_LEN(out_vec));
 
-	psa_close(handle);
-
 	return status;
 }
@@ -11,4 +11,13 @@
 #define MBEDTLS_PK_WRITE_C
 #define MBEDTLS_PK_C
 
+/* Resume sessions with tickets, so reconnects skip the full handshake */
+#define MBEDTLS_SSL_SESSION_TICKETS
+
 #undef MBEDTLS_SSL_MAX_FRAGMENT_LENGTH
+
+#if CONFIG_NONSECURE_COSE_VERIFY_PRECOMP
+/* Keep the comb table of a group's base point, see mbedtls_ecdsa_verify_sign.c */
+#undef MBEDTLS_ECP_FIXED_POINT_OPTIM
+#define MBEDTLS_ECP_FIXED_POINT_OPTIM 1
+#endif
@@ -23,6 +23,8 @@ typedef enum {
 	TEST_HUK_ENC_BUFFER_UNDERFLOW,
 	TEST_HUK_COSE_VERIFY_SIGN,
 	TEST_HUK_VERIFY_COSE_SIGN_FAIL,
+	TEST_HUK_ENC_TENSOR,
+	TEST_HUK_ENC_TENSOR_INVALID_DIMS,
 	TFLM_HUK_MAX_TEST
 } tfm_th_test_list_t;
 
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include <mbedtls/sha256.h>
+#include "cose/cose_verify.h"
+
+#define TEST_BATCH_SIZE         3
+#define TEST_SIG_LEN            64
+
+/* Key the test objects are signed with. The key manager below hands its
+ * public key to the verification cache, in place of the HUK-derived key.
+ */
+static mbedtls_ecp_keypair test_key;
+static struct km_key_context test_km_ctx;
+
+static uint8_t test_obj[TEST_BATCH_SIZE][128];
+static size_t test_obj_len[TEST_BATCH_SIZE];
+
+struct km_key_context *km_get_context(enum km_key_idx key_idx)
+{
+	return key_idx == KEY_COSE ? &test_km_ctx : NULL;
+}
+
+psa_status_t km_get_pubkey(uint8_t *public_key,
+			   size_t public_key_len,
+			   const enum km_key_idx key_idx)
+{
+	size_t len;
+
+	if (key_idx != KEY_COSE ||
+	    mbedtls_ecp_point_write_binary(
+		    &test_key.MBEDTLS_PRIVATE(grp),
+		    &test_key.MBEDTLS_PRIVATE(Q),
+		    MBEDTLS_ECP_PF_UNCOMPRESSED,
+		    &len, public_key, public_key_len) != 0) {
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+
+	return PSA_SUCCESS;
+}
+
+/* The key only has to sign test vectors, so any sequence will do. */
+static int test_rng(void *ctx, unsigned char *buf, size_t len)
+{
+	static uint32_t state = 0x2545f491;
+
+	for (size_t i = 0; i < len; i++) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		buf[i] = (uint8_t)state;
+	}
+
+	return 0;
+}
+
+/* Encode a COSE_Sign1 object of an inference value, signed with test_key. */
+static size_t test_sign1_encode(uint8_t *obj, size_t len_obj, float value)
+{
+	const uint8_t prot[] = { 0xa1, 0x01, 0x26 };    /* { 1: -7 } */
+	uint8_t pld[16], tbs[64], hash[32], sig[TEST_SIG_LEN];
+	nanocbor_encoder_t enc;
+	size_t len_pld;
+	mbedtls_mpi r, s;
+
+	nanocbor_encoder_init(&enc, pld, sizeof(pld));
+	nanocbor_fmt_map(&enc, 1);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE);
+	nanocbor_put_bstr(&enc, (const uint8_t *)&value, sizeof(value));
+	len_pld = nanocbor_encoded_len(&enc);
+
+	/* Sig_structure = [ "Signature1", protected, external_aad, payload ] */
+	nanocbor_encoder_init(&enc, tbs, sizeof(tbs));
+	nanocbor_fmt_array(&enc, 4);
+	nanocbor_put_tstr(&enc, COSE_CONTEXT_SIGN1);
+	nanocbor_put_bstr(&enc, prot, sizeof(prot));
+	nanocbor_put_bstr(&enc, NULL, 0);
+	nanocbor_put_bstr(&enc, pld, len_pld);
+	zassert_equal(0, mbedtls_sha256(tbs, nanocbor_encoded_len(&enc),
+					hash, 0), "Hash failed");
+
+	mbedtls_mpi_init(&r);
+	mbedtls_mpi_init(&s);
+	zassert_equal(0, mbedtls_ecdsa_sign(&test_key.MBEDTLS_PRIVATE(grp),
+					    &r, &s,
+					    &test_key.MBEDTLS_PRIVATE(d),
+					    hash, sizeof(hash),
+					    test_rng, NULL),
+		      "Signing failed");
+	zassert_equal(0, mbedtls_mpi_write_binary(&r, sig, TEST_SIG_LEN / 2) ||
+		      mbedtls_mpi_write_binary(&s, &sig[TEST_SIG_LEN / 2],
+					       TEST_SIG_LEN / 2),
+		      "Signature encode failed");
+	mbedtls_mpi_free(&r);
+	mbedtls_mpi_free(&s);
+
+	nanocbor_encoder_init(&enc, obj, len_obj);
+	nanocbor_fmt_tag(&enc, 18);
+	nanocbor_fmt_array(&enc, 4);
+	nanocbor_put_bstr(&enc, prot, sizeof(prot));
+	nanocbor_fmt_map(&enc, 0);
+	nanocbor_put_bstr(&enc, pld, len_pld);
+	nanocbor_put_bstr(&enc, sig, sizeof(sig));
+
+	return nanocbor_encoded_len(&enc);
+}
+
+static void *cose_batch_setup(void)
+{
+	zassert_equal(COSE_ERROR_NONE, cose_verify_init(),
+		      "COSE verification init failed");
+
+	mbedtls_ecp_keypair_init(&test_key);
+	zassert_equal(0, mbedtls_ecp_gen_key(MBEDTLS_ECP_DP_SECP256R1,
+					     &test_key, test_rng, NULL),
+		      "Key generation failed");
+
+	for (int i = 0; i < TEST_BATCH_SIZE; i++) {
+		test_obj_len[i] = test_sign1_encode(test_obj[i],
+						    sizeof(test_obj[i]),
+						    0.25f * i);
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Test batch verification of good signatures
+ *
+ * This test verifies that a batch of correctly signed objects verifies, both
+ * as a batch and one object at a time.
+ *
+ */
+ZTEST(cose_verify_batch, test_batch_good)
+{
+	const uint8_t *objs[TEST_BATCH_SIZE];
+	int results[TEST_BATCH_SIZE];
+	cose_sign_context_t *ctx;
+	const uint8_t *pld;
+	size_t len_pld;
+
+	zassert_equal(COSE_ERROR_NONE, cose_verify_ctx_get(KEY_COSE, &ctx),
+		      "No verification context");
+
+	for (int i = 0; i < TEST_BATCH_SIZE; i++) {
+		objs[i] = test_obj[i];
+		zassert_equal(COSE_ERROR_NONE,
+			      cose_verify_sign1(ctx, test_obj[i],
+						test_obj_len[i],
+						&pld, &len_pld),
+			      "Object %d rejected", i);
+	}
+
+	zassert_equal(COSE_ERROR_NONE,
+		      cose_verify_sign1_batch(ctx, objs, test_obj_len,
+					      TEST_BATCH_SIZE, results),
+		      "Batch rejected");
+	cose_verify_ctx_put(ctx);
+
+	for (int i = 0; i < TEST_BATCH_SIZE; i++) {
+		zassert_equal(COSE_ERROR_NONE, results[i],
+			      "Object %d rejected", i);
+	}
+}
+
+/**
+ * @brief Test batch verification with a bad signature in the middle
+ *
+ * This test verifies that a bad signature is reported against its own entry
+ * in results, and that the objects around it still verify.
+ *
+ */
+ZTEST(cose_verify_batch, test_batch_bad_middle)
+{
+	static uint8_t bad[sizeof(test_obj[0])];
+	const uint8_t *objs[TEST_BATCH_SIZE];
+	int results[TEST_BATCH_SIZE];
+	cose_sign_context_t *ctx;
+
+	zassert_equal(COSE_ERROR_NONE, cose_verify_ctx_get(KEY_COSE, &ctx),
+		      "No verification context");
+
+	/* The signature is the last member of the object. */
+	memcpy(bad, test_obj[1], test_obj_len[1]);
+	bad[test_obj_len[1] - 1] ^= 0x01;
+
+	objs[0] = test_obj[0];
+	objs[1] = bad;
+	objs[2] = test_obj[2];
+
+	zassert_equal(COSE_ERROR_AUTHENTICATE,
+		      cose_verify_sign1_batch(ctx, objs, test_obj_len,
+					      TEST_BATCH_SIZE, results),
+		      "Batch with a bad signature accepted");
+	cose_verify_ctx_put(ctx);
+
+	zassert_equal(COSE_ERROR_NONE, results[0], "Object 0 rejected");
+	zassert_equal(COSE_ERROR_AUTHENTICATE, results[1],
+		      "Bad signature not reported");
+	zassert_equal(COSE_ERROR_NONE, results[2], "Object 2 rejected");
+}
+
+ZTEST_SUITE(cose_verify_batch, NULL, cose_batch_setup, NULL, NULL, NULL);
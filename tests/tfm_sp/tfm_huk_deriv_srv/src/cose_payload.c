@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/ztest.h>
+#include "cose/cose_verify.h"
+
+/* Label outside of the range known to the decoder */
+#define TEST_LABEL_UNKNOWN      (EAT_CBOR_LINARO_RANGE_BASE - 99)
+
+static uint8_t pld_buf[128];
+
+static void encode_value(nanocbor_encoder_t *enc, float value)
+{
+	nanocbor_fmt_int(enc, EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE);
+	nanocbor_put_bstr(enc, (const uint8_t *)&value, sizeof(value));
+}
+
+/**
+ * @brief Test claims decode
+ *
+ * This test verifies that a 64-bit timestamp is decoded in full, and that
+ * unknown labels are skipped wherever they are in the map.
+ *
+ */
+ZTEST(cose_payload_decode, test_claims_all)
+{
+	const uint64_t timestamp = 12345678901ULL;
+	const char *model = "TFLM_SINE";
+	cose_infer_payload_t pld;
+	nanocbor_encoder_t enc;
+	float value;
+
+	nanocbor_encoder_init(&enc, pld_buf, sizeof(pld_buf));
+	nanocbor_fmt_map(&enc, 7);
+	nanocbor_fmt_int(&enc, TEST_LABEL_UNKNOWN);
+	nanocbor_fmt_array(&enc, 2);
+	nanocbor_fmt_uint(&enc, 1);
+	nanocbor_put_tstr(&enc, "skipped");
+	encode_value(&enc, 0.5f);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_NV_COUNTER_ROLL_OVER);
+	nanocbor_fmt_uint(&enc, 2);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_NV_COUNTER_VALUE);
+	nanocbor_fmt_uint(&enc, 70000);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_LABEL_MODEL_ID);
+	nanocbor_put_tstr(&enc, model);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_LABEL_TIMESTAMP);
+	nanocbor_fmt_uint(&enc, timestamp);
+	nanocbor_fmt_int(&enc, TEST_LABEL_UNKNOWN - 1);
+	nanocbor_fmt_uint(&enc, 3);
+
+	zassert_equal(COSE_ERROR_NONE,
+		      cose_payload_decode_claims(pld_buf,
+						 nanocbor_encoded_len(&enc),
+						 &pld),
+		      "Claims decode failed");
+	zassert_true(pld.has_timestamp, "Timestamp not decoded");
+	zassert_equal(timestamp, pld.timestamp, "Timestamp truncated");
+	zassert_true(pld.has_nv_counter, "NV counter not decoded");
+	zassert_equal(2, pld.nv_rollover, "Wrong NV counter rollover");
+	zassert_equal(70000, pld.nv_counter, "Wrong NV counter");
+	zassert_equal(strlen(model), pld.len_model_id, "Wrong model ID");
+	zassert_mem_equal(model, pld.model_id, pld.len_model_id,
+			  "Wrong model ID");
+	zassert_equal(1, cose_payload_get_count(&pld), "Wrong value count");
+	zassert_equal(COSE_ERROR_NONE, cose_payload_get_float(&pld, 0, &value),
+		      "Value decode failed");
+	zassert_equal(0.5f, value, "Wrong value");
+}
+
+/**
+ * @brief Test claims decode without the optional claims
+ *
+ * This test verifies that only the inference value is required, and that an
+ * NV counter without its rollover count is not reported.
+ *
+ */
+ZTEST(cose_payload_decode, test_claims_optional)
+{
+	cose_infer_payload_t pld;
+	nanocbor_encoder_t enc;
+
+	nanocbor_encoder_init(&enc, pld_buf, sizeof(pld_buf));
+	nanocbor_fmt_map(&enc, 1);
+	encode_value(&enc, 0.5f);
+
+	zassert_equal(COSE_ERROR_NONE,
+		      cose_payload_decode_claims(pld_buf,
+						 nanocbor_encoded_len(&enc),
+						 &pld),
+		      "Claims decode failed");
+	zassert_false(pld.has_timestamp, "Unexpected timestamp");
+	zassert_false(pld.has_nv_counter, "Unexpected NV counter");
+	zassert_is_null(pld.model_id, "Unexpected model ID");
+
+	nanocbor_encoder_init(&enc, pld_buf, sizeof(pld_buf));
+	nanocbor_fmt_map(&enc, 2);
+	encode_value(&enc, 0.5f);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_NV_COUNTER_VALUE);
+	nanocbor_fmt_uint(&enc, 7);
+
+	zassert_equal(COSE_ERROR_NONE,
+		      cose_payload_decode_claims(pld_buf,
+						 nanocbor_encoded_len(&enc),
+						 &pld),
+		      "Claims decode failed");
+	zassert_false(pld.has_nv_counter, "NV counter without rollover");
+}
+
+/**
+ * @brief Test claims decode without an inference value
+ *
+ * This test verifies that a payload missing the inference value is rejected.
+ *
+ */
+ZTEST(cose_payload_decode, test_claims_missing_value)
+{
+	cose_infer_payload_t pld;
+	nanocbor_encoder_t enc;
+
+	nanocbor_encoder_init(&enc, pld_buf, sizeof(pld_buf));
+	nanocbor_fmt_map(&enc, 1);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_LABEL_TIMESTAMP);
+	nanocbor_fmt_uint(&enc, 1);
+
+	zassert_equal(COSE_ERROR_DECODE,
+		      cose_payload_decode_claims(pld_buf,
+						 nanocbor_encoded_len(&enc),
+						 &pld),
+		      "Payload without value accepted");
+}
+
+static size_t encode_tensor(const uint32_t *dims, size_t dims_len,
+			    const int8_t *data, size_t data_len)
+{
+	const float scale = 0.5f;
+	nanocbor_encoder_t enc;
+
+	nanocbor_encoder_init(&enc, pld_buf, sizeof(pld_buf));
+	nanocbor_fmt_map(&enc, 2);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_LABEL_INFERENCE_TENSOR);
+	nanocbor_fmt_tag(&enc, COSE_CBOR_TAG_MULTI_DIM_ARRAY);
+	nanocbor_fmt_array(&enc, 2);
+	nanocbor_fmt_array(&enc, dims_len);
+	for (size_t i = 0; i < dims_len; i++) {
+		nanocbor_fmt_uint(&enc, dims[i]);
+	}
+	nanocbor_fmt_tag(&enc, COSE_CBOR_TAG_TA_SINT8);
+	nanocbor_put_bstr(&enc, (const uint8_t *)data, data_len);
+	nanocbor_fmt_int(&enc, EAT_CBOR_LINARO_LABEL_QUANT_PARAMS);
+	nanocbor_fmt_array(&enc, 2);
+	nanocbor_fmt_tag(&enc, COSE_CBOR_TAG_TA_FLOAT32_LE);
+	nanocbor_put_bstr(&enc, (const uint8_t *)&scale, sizeof(scale));
+	nanocbor_fmt_int(&enc, -2);
+
+	return nanocbor_encoded_len(&enc);
+}
+
+/**
+ * @brief Test tensor decode
+ *
+ * This test verifies that an int8 tensor is decoded and dequantized in
+ * row-major order.
+ *
+ */
+ZTEST(cose_payload_decode, test_tensor)
+{
+	const uint32_t dims[] = { 2, 2 };
+	const int8_t data[] = { -2, 0, 2, 4 };
+	cose_infer_payload_t pld;
+	float value;
+	size_t len;
+
+	len = encode_tensor(dims, ARRAY_SIZE(dims), data, sizeof(data));
+	zassert_equal(COSE_ERROR_NONE,
+		      cose_payload_decode_claims(pld_buf, len, &pld),
+		      "Tensor decode failed");
+	zassert_equal(COSE_TENSOR_INT8, pld.tensor_type, "Wrong tensor type");
+	zassert_equal(2, pld.dims_len, "Wrong tensor rank");
+	zassert_true(pld.has_quant, "Quantization not decoded");
+	zassert_equal(4, cose_payload_get_count(&pld), "Wrong element count");
+	zassert_equal(COSE_ERROR_NONE, cose_payload_get_float(&pld, 3, &value),
+		      "Element decode failed");
+	zassert_equal(3.0f, value, "Wrong dequantized value");
+	zassert_equal(COSE_ERROR_DECODE, cose_payload_get_float(&pld, 4, &value),
+		      "Out of bounds element decoded");
+}
+
+/**
+ * @brief Test tensor decode with invalid dims
+ *
+ * This test verifies that dims whose product wraps around to the size of the
+ * data, and zero dims, are rejected.
+ *
+ */
+ZTEST(cose_payload_decode, test_tensor_invalid_dims)
+{
+	const uint32_t dims_wrap[] = { 4, 0x40000001 };
+	const uint32_t dims_zero[] = { 4, 0 };
+	const int8_t data[] = { -2, 0, 2, 4 };
+	cose_infer_payload_t pld;
+	size_t len;
+
+	len = encode_tensor(dims_wrap, ARRAY_SIZE(dims_wrap),
+			    data, sizeof(data));
+	zassert_equal(COSE_ERROR_DECODE,
+		      cose_payload_decode_claims(pld_buf, len, &pld),
+		      "Overflowing dims accepted");
+
+	len = encode_tensor(dims_zero, ARRAY_SIZE(dims_zero), NULL, 0);
+	zassert_equal(COSE_ERROR_DECODE,
+		      cose_payload_decode_claims(pld_buf, len, &pld),
+		      "Zero dim accepted");
+}
+
+ZTEST_SUITE(cose_payload_decode, NULL, NULL, NULL, NULL, NULL);
@@ -37,5 +37,37 @@ ZTEST(tfm_huk_cose_enc_sign, test_huk_cose_enc_sign){
 	zassert_equal(TEST_SUCCEED, test_status, "test_huk_cose_enc_sign test failed");
 }
 
+/**
+ * @brief Test COSE encode sign of a tensor
+ *
+ * This test verifies COSE encode sign of an int8 tensor.
+ *
+ */
+ZTEST(tfm_huk_tensor_enc, test_huk_tensor_enc){
+	psa_status_t status;
+	test_run_status_t test_status = TEST_FAILED;
+
+	status = psa_test_helper(TEST_HUK_ENC_TENSOR, &test_status);
+	zassert_equal(PSA_SUCCESS, status, "PSA test helper API called failed");
+	zassert_equal(TEST_SUCCEED, test_status, "test_huk_tensor_enc test failed");
+}
+
+/**
+ * @brief Test tensor encode with invalid dims
+ *
+ * This test verifies that overflowing and zero dims are rejected.
+ *
+ */
+ZTEST(tfm_huk_tensor_enc, test_huk_tensor_enc_invalid_dims){
+	psa_status_t status;
+	test_run_status_t test_status = TEST_FAILED;
+
+	status = psa_test_helper(TEST_HUK_ENC_TENSOR_INVALID_DIMS, &test_status);
+	zassert_equal(PSA_SUCCESS, status, "PSA test helper API called failed");
+	zassert_equal(TEST_SUCCEED, test_status,
+		      "test_huk_tensor_enc_invalid_dims test failed");
+}
+
 ZTEST_SUITE(tfm_huk_cbor_enc, NULL, NULL, NULL, NULL, NULL);
 ZTEST_SUITE(tfm_huk_cose_enc_sign, NULL, NULL, NULL, NULL, NULL);
+ZTEST_SUITE(tfm_huk_tensor_enc, NULL, NULL, NULL, NULL, NULL);
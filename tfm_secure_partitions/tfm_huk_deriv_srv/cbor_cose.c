@@ -77,29 +77,146 @@ psa_status_t tfm_cose_encode_start(psa_key_handle_t key_handle,
 	return return_value;
 }
 
+/* Size of one tensor element, 0 for an unknown type */
+static size_t tfm_cbor_tensor_elem_size(huk_tensor_type_t type)
+{
+	switch (type) {
+	case HUK_TENSOR_FLOAT32:
+		return sizeof(float);
+	case HUK_TENSOR_INT8:
+		return sizeof(int8_t);
+	case HUK_TENSOR_INT16:
+		return sizeof(int16_t);
+	default:
+		return 0;
+	}
+}
+
+/* RFC 8746 typed array tag of a tensor element type */
+static uint64_t tfm_cbor_tensor_tag(huk_tensor_type_t type)
+{
+	switch (type) {
+	case HUK_TENSOR_INT8:
+		return TFM_CBOR_TAG_TA_SINT8;
+	case HUK_TENSOR_INT16:
+		return TFM_CBOR_TAG_TA_SINT16_LE;
+	default:
+		return TFM_CBOR_TAG_TA_FLOAT32_LE;
+	}
+}
+
+/* Add the inference output to the open payload map. A NULL desc adds a single
+ * float as a byte string, otherwise the tensor is added as a row-major
+ * multi-dimensional typed array, followed by its quantization parameters.
+ */
+static psa_status_t tfm_cbor_add_inference(QCBOREncodeContext *cbor_enc_ctx,
+					   const huk_tensor_desc_t *desc,
+					   const void *data,
+					   size_t data_len)
+{
+	struct q_useful_buf_c data_buf;
+	size_t elem_size;
+	size_t count = 1;
+	uint32_t i;
+
+	data_buf.ptr = data;
+	data_buf.len = data_len;
+
+	if (desc == NULL) {
+		if (data_len != sizeof(float)) {
+			return PSA_ERROR_INVALID_ARGUMENT;
+		}
+		QCBOREncode_AddBytesToMapN(cbor_enc_ctx,
+					   EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE,
+					   data_buf);
+		return PSA_SUCCESS;
+	}
+
+	elem_size = tfm_cbor_tensor_elem_size(desc->type);
+	if (elem_size == 0 || desc->dims_len == 0 ||
+	    desc->dims_len > HUK_TENSOR_MAX_DIMS) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+	/* Bound the element count before each multiplication, so that
+	 * oversized dims cannot wrap around to match data_len.
+	 */
+	for (i = 0; i < desc->dims_len; i++) {
+		if (desc->dims[i] == 0 ||
+		    count > (HUK_TENSOR_MAX_SIZE / elem_size) / desc->dims[i]) {
+			return PSA_ERROR_INVALID_ARGUMENT;
+		}
+		count *= desc->dims[i];
+	}
+	if (count * elem_size != data_len) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	QCBOREncode_AddInt64(cbor_enc_ctx,
+			     EAT_CBOR_LINARO_LABEL_INFERENCE_TENSOR);
+	QCBOREncode_AddTag(cbor_enc_ctx, TFM_CBOR_TAG_MULTI_DIM_ARRAY);
+	QCBOREncode_OpenArray(cbor_enc_ctx);
+	QCBOREncode_OpenArray(cbor_enc_ctx);
+	for (i = 0; i < desc->dims_len; i++) {
+		QCBOREncode_AddUInt64(cbor_enc_ctx, desc->dims[i]);
+	}
+	QCBOREncode_CloseArray(cbor_enc_ctx);
+	QCBOREncode_AddTag(cbor_enc_ctx, tfm_cbor_tensor_tag(desc->type));
+	QCBOREncode_AddBytes(cbor_enc_ctx, data_buf);
+	QCBOREncode_CloseArray(cbor_enc_ctx);
+
+	if (desc->type != HUK_TENSOR_FLOAT32) {
+		/* The scale is a one element float32 typed array, so that
+		 * decoders do not need CBOR floating point support.
+		 */
+		data_buf.ptr = &desc->scale;
+		data_buf.len = sizeof(desc->scale);
+		QCBOREncode_OpenArrayInMapN(cbor_enc_ctx,
+					    EAT_CBOR_LINARO_LABEL_QUANT_PARAMS);
+		QCBOREncode_AddTag(cbor_enc_ctx, TFM_CBOR_TAG_TA_FLOAT32_LE);
+		QCBOREncode_AddBytes(cbor_enc_ctx, data_buf);
+		QCBOREncode_AddInt64(cbor_enc_ctx, desc->zero_point);
+		QCBOREncode_CloseArray(cbor_enc_ctx);
+	}
+
+	return PSA_SUCCESS;
+}
+
 psa_status_t tfm_cbor_encode(float inf_val,
 			     uint8_t *inf_val_encoded_buf,
 			     size_t inf_val_encoded_buf_size,
 			     size_t *inf_val_encoded_buf_len)
+{
+	return tfm_cbor_encode_tensor(NULL,
+				      &inf_val,
+				      sizeof(inf_val),
+				      inf_val_encoded_buf,
+				      inf_val_encoded_buf_size,
+				      inf_val_encoded_buf_len);
+}
+
+psa_status_t tfm_cbor_encode_tensor(const huk_tensor_desc_t *desc,
+				    const void *data,
+				    size_t data_len,
+				    uint8_t *inf_val_encoded_buf,
+				    size_t inf_val_encoded_buf_size,
+				    size_t *inf_val_encoded_buf_len)
 {
 	QCBOREncodeContext cbor_enc_ctx;
-	struct q_useful_buf_c inf_val_buf;
 	struct q_useful_buf inf_val_encode;
 	struct q_useful_buf_c completed_inf_val_encode;
 	QCBORError qcbor_result;
+	psa_status_t status;
 
 	inf_val_encode.ptr = inf_val_encoded_buf;
 	inf_val_encode.len = inf_val_encoded_buf_size;
 
 	QCBOREncode_Init(&cbor_enc_ctx, inf_val_encode);
 
-	inf_val_buf.ptr = &inf_val;
-	inf_val_buf.len = sizeof(inf_val);
-
 	QCBOREncode_OpenMap(&cbor_enc_ctx);
-	QCBOREncode_AddBytesToMapN(&cbor_enc_ctx,
-				   EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE,
-				   inf_val_buf);
+	status = tfm_cbor_add_inference(&cbor_enc_ctx, desc, data, data_len);
+	if (status != PSA_SUCCESS) {
+		return status;
+	}
 	QCBOREncode_CloseMap(&cbor_enc_ctx);
 
 	qcbor_result = QCBOREncode_Finish(&cbor_enc_ctx, &completed_inf_val_encode);
@@ -174,6 +291,23 @@ psa_status_t tfm_cose_encode_sign(psa_key_handle_t key_handle,
 				  uint8_t *inf_val_encoded_buf,
 				  size_t inf_val_encoded_buf_size,
 				  size_t *inf_val_encoded_buf_len)
+{
+	return tfm_cose_encode_sign_tensor(key_handle,
+					   NULL,
+					   &inf_val,
+					   sizeof(inf_val),
+					   inf_val_encoded_buf,
+					   inf_val_encoded_buf_size,
+					   inf_val_encoded_buf_len);
+}
+
+psa_status_t tfm_cose_encode_sign_tensor(psa_key_handle_t key_handle,
+					 const huk_tensor_desc_t *desc,
+					 const void *data,
+					 size_t data_len,
+					 uint8_t *inf_val_encoded_buf,
+					 size_t inf_val_encoded_buf_size,
+					 size_t *inf_val_encoded_buf_len)
 {
 	psa_status_t status = PSA_SUCCESS;
 	struct tfm_cose_encode_ctx encode_ctx;
@@ -195,10 +329,10 @@ psa_status_t tfm_cose_encode_sign(psa_key_handle_t key_handle,
 		return status;
 	}
 
-	status = tfm_cose_add_data(&encode_ctx,
-				   EAT_CBOR_LINARO_LABEL_INFERENCE_VALUE,
-				   (void *)&inf_val,
-				   sizeof(inf_val));
+	status = tfm_cbor_add_inference(&encode_ctx.cbor_enc_ctx,
+					desc,
+					data,
+					data_len);
 	if (status != PSA_SUCCESS) {
 		return status;
 	}
@@ -50,6 +50,18 @@ struct tfm_cose_encode_ctx {
 #define EAT_CBOR_LINARO_NV_COUNTER_VALUE               (EAT_CBOR_LINARO_RANGE_BASE - 6)
 #endif
 
+/* Reserved for the model ID and inference timestamp claims */
+#define EAT_CBOR_LINARO_LABEL_MODEL_ID                 (EAT_CBOR_LINARO_RANGE_BASE - 7)
+#define EAT_CBOR_LINARO_LABEL_TIMESTAMP                (EAT_CBOR_LINARO_RANGE_BASE - 8)
+#define EAT_CBOR_LINARO_LABEL_INFERENCE_TENSOR         (EAT_CBOR_LINARO_RANGE_BASE - 9)
+#define EAT_CBOR_LINARO_LABEL_QUANT_PARAMS             (EAT_CBOR_LINARO_RANGE_BASE - 10)
+
+/* RFC 8746 tags used for output tensors */
+#define TFM_CBOR_TAG_MULTI_DIM_ARRAY                   40
+#define TFM_CBOR_TAG_TA_SINT8                          72
+#define TFM_CBOR_TAG_TA_SINT16_LE                      77
+#define TFM_CBOR_TAG_TA_FLOAT32_LE                     85
+
 #ifdef __cplusplus
 }
 #endif
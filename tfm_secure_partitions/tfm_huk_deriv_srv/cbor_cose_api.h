@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include "psa/service.h"
 #include "cbor_cose.h"
+#include "tfm_huk_deriv_srv_api.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,6 +36,31 @@ psa_status_t tfm_cose_encode_sign(psa_key_handle_t key_handle,
 				  size_t inf_val_encoded_buf_size,
 				  size_t *inf_val_encoded_buf_len);
 
+/**
+ * \brief CBOR encode and sign an output tensor using private key of the given
+ * key handle.
+ *
+ * \param[in]   key_handle                Key handle.
+ * \param[in]   desc                      Tensor type, shape and quantization,
+ *                                        or NULL to encode a single float.
+ * \param[in]   data                      Tensor data, in row-major order.
+ * \param[in]   data_len                  Size of the tensor data in bytes.
+ * \param[out]  inf_val_encoded_buf       Buffer to which encoded data
+ *                                        is written into.
+ * \param[in]   inf_val_encoded_buf_size  Size of inf_val_encoded_buf in bytes.
+ * \param[out]  inf_val_encoded_buf_len   Encoded and signed payload len in
+ *                                        bytes.
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t tfm_cose_encode_sign_tensor(psa_key_handle_t key_handle,
+					 const huk_tensor_desc_t *desc,
+					 const void *data,
+					 size_t data_len,
+					 uint8_t *inf_val_encoded_buf,
+					 size_t inf_val_encoded_buf_size,
+					 size_t *inf_val_encoded_buf_len);
+
 /**
  * \brief Encoding the inference value in CBOR format.
  *
@@ -52,6 +78,27 @@ psa_status_t tfm_cbor_encode(float inf_val,
 			     size_t inf_val_encoded_buf_size,
 			     size_t *inf_val_encoded_buf_len);
 
+/**
+ * \brief Encoding an output tensor in CBOR format.
+ *
+ * \param[in]   desc                      Tensor type, shape and quantization,
+ *                                        or NULL to encode a single float.
+ * \param[in]   data                      Tensor data, in row-major order.
+ * \param[in]   data_len                  Size of the tensor data in bytes.
+ * \param[out]  inf_val_encoded_buf       Buffer to which encoded data
+ *                                        is written into.
+ * \param[in]   inf_val_encoded_buf_size  Size of inf_val_encoded_buf in bytes.
+ * \param[out]  inf_val_encoded_buf_len   Encoded payload len in bytes.
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t tfm_cbor_encode_tensor(const huk_tensor_desc_t *desc,
+				    const void *data,
+				    size_t data_len,
+				    uint8_t *inf_val_encoded_buf,
+				    size_t inf_val_encoded_buf_size,
+				    size_t *inf_val_encoded_buf_len);
+
 /**
  * \brief This function sets up the CBOR and COSE contexts.
  *
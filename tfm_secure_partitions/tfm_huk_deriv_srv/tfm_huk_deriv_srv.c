@@ -421,21 +421,48 @@ err:
 static psa_status_t tfm_huk_cose_encode_sign
 	(psa_msg_t *msg)
 {
+	/* Static, as they are too large for the partition stack. Messages are
+	 * handled one at a time.
+	 */
+	static uint8_t inf_data[HUK_TENSOR_MAX_SIZE];
+	static uint8_t inf_val_encoded_buf[HUK_ENC_MAX_SIZE];
 	psa_status_t status = PSA_SUCCESS;
 	huk_enc_format_t enc_format;
-	uint8_t inf_val_encoded_buf[msg->out_size[0]];
+	size_t inf_val_encoded_buf_size = msg->out_size[0];
 	size_t inf_val_encoded_buf_len = 0;
-	float inf_value = 0;
+	huk_tensor_desc_t tensor_desc;
+	huk_tensor_desc_t *desc = NULL;
+	size_t inf_data_len = msg->in_size[0];
 	psa_key_handle_t key_handle;
 
+	/* A tensor descriptor in invec 2 selects a tensor payload, otherwise
+	 * invec 0 holds a single float.
+	 */
+	if (msg->in_size[2] == sizeof(tensor_desc)) {
+		psa_read(msg->handle, 2, &tensor_desc, sizeof(tensor_desc));
+		desc = &tensor_desc;
+	}
+	if (msg->in_size[1] != sizeof(enc_format) ||
+	    inf_data_len == 0 ||
+	    inf_data_len > (desc ? HUK_TENSOR_MAX_SIZE : sizeof(float))) {
+		log_err_print("Invalid inference output size %d", inf_data_len);
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+	/* Callers may pass larger buffers than any output needs */
+	if (inf_val_encoded_buf_size > sizeof(inf_val_encoded_buf)) {
+		inf_val_encoded_buf_size = sizeof(inf_val_encoded_buf);
+	}
+
 	psa_read(msg->handle, 1, &enc_format, msg->in_size[1]);
-	psa_read(msg->handle, 0, &inf_value, msg->in_size[0]);
+	psa_read(msg->handle, 0, inf_data, inf_data_len);
 
 	if (enc_format == HUK_ENC_CBOR) {
-		status = tfm_cbor_encode(inf_value,
-					 inf_val_encoded_buf,
-					 msg->out_size[0],
-					 &inf_val_encoded_buf_len);
+		status = tfm_cbor_encode_tensor(desc,
+						inf_data,
+						inf_data_len,
+						inf_val_encoded_buf,
+						inf_val_encoded_buf_size,
+						&inf_val_encoded_buf_len);
 		if (status != PSA_SUCCESS) {
 			log_err_print("failed with %d", status);
 			return status;
@@ -451,11 +478,13 @@ static psa_status_t tfm_huk_cose_encode_sign
 		tfm_inc_nv_ps_counter_tracker(NV_PS_COUNTER_TRACKER);
 #endif
 
-		status = tfm_cose_encode_sign(key_handle,
-					      inf_value,
-					      inf_val_encoded_buf,
-					      msg->out_size[0],
-					      &inf_val_encoded_buf_len);
+		status = tfm_cose_encode_sign_tensor(key_handle,
+						     desc,
+						     inf_data,
+						     inf_data_len,
+						     inf_val_encoded_buf,
+						     inf_val_encoded_buf_size,
+						     &inf_val_encoded_buf_len);
 		if (status != PSA_SUCCESS) {
 			log_err_print("failed with %d", status);
 			return status;
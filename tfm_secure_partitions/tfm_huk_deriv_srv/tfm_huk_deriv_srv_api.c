@@ -42,3 +42,43 @@ psa_status_t psa_huk_cose_sign(float *inf_value,
 
 	return status;
 }
+
+psa_status_t psa_huk_cose_sign_tensor(const huk_tensor_desc_t *desc,
+				      const void *data,
+				      size_t data_len,
+				      huk_enc_format_t enc_format,
+				      uint8_t *encoded_buf,
+				      size_t encoded_buf_size,
+				      size_t *encoded_buf_len)
+{
+	psa_status_t status;
+	psa_handle_t handle;
+
+	psa_invec in_vec[] = {
+		{ .base = data, .len = data_len },
+		{ .base = &enc_format, .len = sizeof(huk_enc_format_t) },
+		{ .base = desc, .len = sizeof(huk_tensor_desc_t) },
+	};
+
+	psa_outvec out_vec[] = {
+		{ .base = encoded_buf, .len = encoded_buf_size },
+		{ .base = encoded_buf_len, .len = sizeof(size_t) },
+	};
+
+	handle = psa_connect(TFM_HUK_COSE_CBOR_ENC_SIGN_SID,
+			     TFM_HUK_COSE_CBOR_ENC_SIGN_VERSION);
+	if (!PSA_HANDLE_IS_VALID(handle)) {
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+
+	status = psa_call(handle,
+			  PSA_IPC_CALL,
+			  in_vec,
+			  IOVEC_LEN(in_vec),
+			  out_vec,
+			  IOVEC_LEN(out_vec));
+
+	psa_close(handle);
+
+	return status;
+}
@@ -42,6 +42,39 @@ typedef enum {
 	HUK_ENC_NONE,
 } huk_enc_format_t;
 
+/** Representation requested for the inference output. */
+typedef enum {
+	HUK_OUT_FLOAT = 0,              /**< Dequantized float values. */
+	HUK_OUT_INT8,                   /**< Raw int8 tensor and quantization. */
+} huk_out_format_t;
+
+/** Element type of an inference output tensor. */
+typedef enum {
+	HUK_TENSOR_FLOAT32 = 0,         /**< IEEE 754 single precision. */
+	HUK_TENSOR_INT8,                /**< Quantized signed 8-bit. */
+	HUK_TENSOR_INT16,               /**< Quantized signed 16-bit. */
+} huk_tensor_type_t;
+
+/** Maximum number of dimensions of an output tensor. */
+#define HUK_TENSOR_MAX_DIMS     4
+/** Maximum size in bytes of the output tensor data. */
+#define HUK_TENSOR_MAX_SIZE     1024
+/** Maximum size in bytes of an encoded inference output, the tensor data
+ * plus room for its claims, the COSE headers and the signature.
+ */
+#define HUK_ENC_MAX_SIZE        (HUK_TENSOR_MAX_SIZE + 256)
+
+/** Type, shape and quantization parameters of an output tensor. */
+typedef struct {
+	huk_tensor_type_t type;
+	uint32_t dims_len;
+	uint32_t dims[HUK_TENSOR_MAX_DIMS];
+	/** Quantization scale, unused for HUK_TENSOR_FLOAT32. */
+	float scale;
+	/** Quantization zero point, unused for HUK_TENSOR_FLOAT32. */
+	int32_t zero_point;
+} huk_tensor_desc_t;
+
 /**
  * \brief COSE CBOR encode and sign
  *
@@ -61,4 +94,29 @@ psa_status_t psa_huk_cose_sign(float *inf_value,
 			       size_t encoded_buf_size,
 			       size_t *encoded_buf_len);
 
+/**
+ * \brief COSE CBOR encode and sign an output tensor
+ *
+ * The tensor is encoded as an RFC 8746 multi-dimensional typed array, along
+ * with its quantization parameters for the integer types.
+ *
+ * \param[in]  desc             Tensor type, shape and quantization
+ * \param[in]  data             Tensor data, in row-major order
+ * \param[in]  data_len         Size of the tensor data in bytes
+ * \param[in]  enc_format       Requested encoding format
+ * \param[out] encoded_buf      Buffer to which encoded data
+ *                              is written into
+ * \param[in]  encoded_buf_size Size of encoded_buf in bytes
+ * \param[out] encoded_buf_len  Encoded buffer len in bytes
+ *
+ * \return A status indicating the success/failure of the operation
+ */
+psa_status_t psa_huk_cose_sign_tensor(const huk_tensor_desc_t *desc,
+				      const void *data,
+				      size_t data_len,
+				      huk_enc_format_t enc_format,
+				      uint8_t *encoded_buf,
+				      size_t encoded_buf_size,
+				      size_t *encoded_buf_len);
+
 #endif // __TFM_HUK_DERIV_SRV_API_H__
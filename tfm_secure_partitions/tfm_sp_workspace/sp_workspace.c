@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdbool.h>
+
+#include "tfm_sp_log.h"
+#include "../tfm_huk_deriv_srv/tfm_huk_deriv_srv_api.h"
+#include "sp_workspace.h"
+
+#define SERV_NAME "SP WORKSPACE"
+
+static uint8_t sp_workspace_pool[SP_WORKSPACE_SIZE] __attribute__((aligned(16)));
+
+/* Owner whose state is in the pool, SP_WORKSPACE_OWNER_COUNT if none. */
+static sp_workspace_owner_t sp_workspace_last_owner = SP_WORKSPACE_OWNER_COUNT;
+
+/* Owner in the middle of a request, SP_WORKSPACE_OWNER_COUNT if none. */
+static sp_workspace_owner_t sp_workspace_holder = SP_WORKSPACE_OWNER_COUNT;
+
+static uint32_t sp_workspace_generation;
+
+psa_status_t sp_workspace_acquire(sp_workspace_owner_t owner,
+				  size_t size,
+				  uint8_t **buf,
+				  uint32_t *generation)
+{
+	if (owner >= SP_WORKSPACE_OWNER_COUNT || buf == NULL ||
+	    generation == NULL) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	if (size > sizeof(sp_workspace_pool)) {
+		log_err_print("%d bytes requested, pool is %d bytes",
+			      (int)size, (int)sizeof(sp_workspace_pool));
+		return PSA_ERROR_INSUFFICIENT_MEMORY;
+	}
+
+	if (sp_workspace_holder != SP_WORKSPACE_OWNER_COUNT &&
+	    sp_workspace_holder != owner) {
+		log_err_print("pool is held by owner %d", sp_workspace_holder);
+		return PSA_ERROR_BAD_STATE;
+	}
+
+	if (sp_workspace_last_owner != owner) {
+		sp_workspace_last_owner = owner;
+		sp_workspace_generation++;
+	}
+
+	sp_workspace_holder = owner;
+	*buf = sp_workspace_pool;
+	*generation = sp_workspace_generation;
+
+	return PSA_SUCCESS;
+}
+
+void sp_workspace_release(sp_workspace_owner_t owner)
+{
+	if (sp_workspace_holder == owner) {
+		sp_workspace_holder = SP_WORKSPACE_OWNER_COUNT;
+	}
+}
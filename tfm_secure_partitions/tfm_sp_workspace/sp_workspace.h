@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2022 Linaro Limited
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef __SP_WORKSPACE_H__
+#define __SP_WORKSPACE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psa/client.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Inference engines sharing the workspace pool. */
+typedef enum {
+	SP_WORKSPACE_OWNER_TFLM = 0,    /**< TFLM tensor arena */
+	SP_WORKSPACE_OWNER_UTVM,        /**< UTVM stack memory manager */
+	SP_WORKSPACE_OWNER_COUNT,       /**< Number of owners */
+} sp_workspace_owner_t;
+
+/**
+ * \brief Get the shared workspace pool for the given owner, for the duration
+ *        of the current request.
+ *
+ * The pool is laid out in the application RoT data region, so it is only
+ * reachable from every engine at TF-M isolation levels 1 and 2. At level 3,
+ * each partition has a private data region, and the engines need an arena
+ * of their own instead.
+ *
+ * Ownership is never taken away from a partition by another partition's
+ * thread. Instead, the pool keeps a generation number, which is incremented
+ * each time it is acquired by a different owner than the last one. An owner
+ * records the generation it built its state at, and when acquire returns a
+ * different one, it must drop every reference it holds into the pool and
+ * rebuild its state, from its own thread.
+ *
+ * The pool is held from acquire until sp_workspace_release() is called at
+ * the end of the request. Secure calls from the NS side are serialised by
+ * the TF-M NS interface, and app RoT partitions are only switched on PSA API
+ * calls, so two requests should never hold the pool at once. If they do,
+ * acquire fails rather than handing out a pool that is in use.
+ *
+ * \param[in]   owner           Engine requesting the pool
+ * \param[in]   size            Minimum number of bytes required
+ * \param[out]  buf             Start of the pool, 16-byte aligned
+ * \param[out]  generation      Current generation of the pool
+ *
+ * \return Returns error code as specified in \ref psa_status_t, or
+ *         PSA_ERROR_BAD_STATE if another owner is holding the pool
+ */
+psa_status_t sp_workspace_acquire(sp_workspace_owner_t owner,
+				  size_t size,
+				  uint8_t **buf,
+				  uint32_t *generation);
+
+/**
+ * \brief Stop holding the pool at the end of a request. The state built in it
+ *        stays valid until another owner acquires the pool. Does nothing if
+ *        the owner is not holding the pool.
+ *
+ * \param[in]   owner           Engine releasing the pool
+ */
+void sp_workspace_release(sp_workspace_owner_t owner);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SP_WORKSPACE_H__ */
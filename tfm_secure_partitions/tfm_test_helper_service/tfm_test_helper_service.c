@@ -26,6 +26,71 @@
 #define INFER_ENC_MAX_VALUE_SZ (256)
 
 typedef psa_status_t (*signal_handler_t)(psa_msg_t *);
+
+/**
+ * \brief Encode and sign a 2x2 int8 tensor
+ */
+static psa_status_t tfm_test_helper_enc_tensor(uint8_t *encoded_buf,
+					       size_t encoded_buf_size,
+					       size_t *encoded_buf_len)
+{
+	const int8_t data[] = { -128, -1, 0, 127 };
+	huk_tensor_desc_t desc = {
+		.type = HUK_TENSOR_INT8,
+		.dims_len = 2,
+		.dims = { 2, 2 },
+		.scale = 0.0078125,
+		.zero_point = -1,
+	};
+
+	return psa_huk_cose_sign_tensor(&desc,
+					data,
+					sizeof(data),
+					HUK_ENC_COSE_SIGN1,
+					encoded_buf,
+					encoded_buf_size,
+					encoded_buf_len);
+}
+
+/**
+ * \brief Check that tensors with an invalid shape are rejected
+ */
+static psa_status_t tfm_test_helper_enc_tensor_invalid_dims(
+	uint8_t *encoded_buf,
+	size_t encoded_buf_size,
+	size_t *encoded_buf_len)
+{
+	const int8_t data[4] = { 0 };
+	/* The product of the dims wraps around to 4 on 32-bit targets */
+	const uint32_t dims_wrap[] = { 4, 0x40000001 };
+	const uint32_t dims_zero[] = { 4, 0 };
+	huk_tensor_desc_t desc = {
+		.type = HUK_TENSOR_INT8,
+		.dims_len = 2,
+	};
+	psa_status_t status;
+
+	memcpy(desc.dims, dims_wrap, sizeof(dims_wrap));
+	status = psa_huk_cose_sign_tensor(&desc, data, sizeof(data),
+					  HUK_ENC_CBOR, encoded_buf,
+					  encoded_buf_size, encoded_buf_len);
+	if (status != PSA_ERROR_INVALID_ARGUMENT) {
+		log_err_print("overflowing dims, status %d", status);
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+
+	memcpy(desc.dims, dims_zero, sizeof(dims_zero));
+	status = psa_huk_cose_sign_tensor(&desc, data, sizeof(data),
+					  HUK_ENC_CBOR, encoded_buf,
+					  encoded_buf_size, encoded_buf_len);
+	if (status != PSA_ERROR_INVALID_ARGUMENT) {
+		log_err_print("zero dim, status %d", status);
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+
+	return PSA_SUCCESS;
+}
+
 /**
  * \brief Run tfm test helper service
  */
@@ -88,6 +153,28 @@ psa_status_t tfm_test_helper_run(psa_msg_t *msg)
 	case TEST_HUK_VERIFY_COSE_SIGN_FAIL:
 		log_info_print("TEST: COSE Sign failed");
 		break;
+	case TEST_HUK_ENC_TENSOR:
+		log_info_print("TEST: Starting COSE SIGN of a tensor");
+		status = tfm_test_helper_enc_tensor(encoded_buf,
+						    INFER_ENC_MAX_VALUE_SZ,
+						    &encoded_buf_len);
+		if (status != PSA_SUCCESS) {
+			log_err_print("failed with %d", status);
+			goto err;
+		}
+		sts = TEST_SUCCEED;
+		break;
+	case TEST_HUK_ENC_TENSOR_INVALID_DIMS:
+		log_info_print("TEST: Tensor with invalid dims");
+		status = tfm_test_helper_enc_tensor_invalid_dims(
+			encoded_buf,
+			INFER_ENC_MAX_VALUE_SZ,
+			&encoded_buf_len);
+		if (status != PSA_SUCCESS) {
+			goto err;
+		}
+		sts = TEST_SUCCEED;
+		break;
 	}
 	psa_write(msg->handle,
 		  0,
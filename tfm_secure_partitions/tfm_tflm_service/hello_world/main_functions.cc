@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "main_functions.h"
 
+#include <new>
+#include <string.h>
+
 #include "tensorflow/lite/micro/all_ops_resolver.h"
 #include "constants.h"
 #include "hello_world_model_data.h"
 #include "output_handler.h"
+#include "tensorflow/lite/micro/memory_helpers.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/micro/system_setup.h"
@@ -26,19 +30,36 @@ limitations under the License.
 
 // Globals, used for compatibility with Arduino-style sketches.
 namespace {
+// Exposes the evaluation tensors, so that variable tensors can be saved and
+// restored between streams.
+class StatefulMicroInterpreter : public tflite::MicroInterpreter {
+ public:
+  using tflite::MicroInterpreter::MicroInterpreter;
+
+  TfLiteEvalTensor* eval_tensor(int index) {
+    return context().GetEvalTensor(&context(), index);
+  }
+};
+
 tflite::ErrorReporter* error_reporter = nullptr;
 const tflite::Model* model = nullptr;
-tflite::MicroInterpreter* interpreter = nullptr;
+StatefulMicroInterpreter* interpreter = nullptr;
 TfLiteTensor* input = nullptr;
 TfLiteTensor* output = nullptr;
 int inference_count = 0;
 
-constexpr int kTensorArenaSize = 2000;
-uint8_t tensor_arena[kTensorArenaSize];
+// Backing storage for the interpreter. The interpreter is constructed in
+// place on every setup() so that it can be rebuilt on a different arena after
+// the model has been evicted by the TFLM service.
+alignas(StatefulMicroInterpreter) uint8_t
+    interpreter_buffer[sizeof(StatefulMicroInterpreter)];
 }  // namespace
 
 // The name of this function is important for Arduino compatibility.
-void setup() {
+int setup(uint8_t* tensor_arena, size_t tensor_arena_size) {
+  if (interpreter != nullptr) {
+    teardown();
+  }
 
   tflite::InitializeTarget();
 
@@ -56,7 +77,7 @@ void setup() {
                          "Model provided is schema version %d not equal "
                          "to supported version %d.",
                          model->version(), TFLITE_SCHEMA_VERSION);
-    return;
+    return -1;
   }
 
   // This pulls in all the operation implementations we need.
@@ -64,15 +85,15 @@ void setup() {
   static tflite::AllOpsResolver resolver;
 
   // Build an interpreter to run the model with.
-  static tflite::MicroInterpreter static_interpreter(
-      model, resolver, tensor_arena, kTensorArenaSize, error_reporter);
-  interpreter = &static_interpreter;
+  interpreter = new (interpreter_buffer) StatefulMicroInterpreter(
+      model, resolver, tensor_arena, tensor_arena_size, error_reporter);
 
   // Allocate memory from the tensor_arena for the model's tensors.
   TfLiteStatus allocate_status = interpreter->AllocateTensors();
   if (allocate_status != kTfLiteOk) {
     TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
-    return;
+    teardown();
+    return -1;
   }
 
   // Obtain pointers to the model's input and output tensors.
@@ -81,10 +102,33 @@ void setup() {
 
   // Keep track of how many inferences we have performed.
   inference_count = 0;
+
+  return 0;
 }
 
-// The name of this function is important for Arduino compatibility.
-float loop(float x_value) {
+void teardown() {
+  if (interpreter == nullptr) {
+    return;
+  }
+
+  // The arena is owned by the caller, so only the interpreter state that
+  // references it has to be dropped here.
+  interpreter->~MicroInterpreter();
+  interpreter = nullptr;
+  input = nullptr;
+  output = nullptr;
+}
+
+void discard() {
+  // The destructor walks the allocations the interpreter made in the arena,
+  // which are garbage by now. Nothing outside the arena needs to be freed.
+  interpreter = nullptr;
+  input = nullptr;
+  output = nullptr;
+}
+
+// Quantizes x_value into the input tensor.
+static void quantize_input(float x_value) {
   // Calculate an x value to feed into the model. We compare the current
   // inference_count to the number of inferences per cycle to determine
   // our position within the range of possible x values the model was
@@ -97,15 +141,20 @@ float loop(float x_value) {
   int8_t x_quantized = x_value / input->params.scale + input->params.zero_point;
   // Place the quantized input in the model's input tensor
   input->data.int8[0] = x_quantized;
+}
 
+// Runs the model on the current content of the input tensor.
+static TfLiteStatus invoke() {
   // Run inference, and report any error
   TfLiteStatus invoke_status = interpreter->Invoke();
   if (invoke_status != kTfLiteOk) {
-    TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed on x: %f\n",
-                         static_cast<double>(x_value));
-    return -1;
+    TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed\n");
   }
+  return invoke_status;
+}
 
+// Dequantizes the first value of the output tensor.
+static float dequantize_output() {
   // Obtain the quantized output from model's output tensor
   int8_t y_quantized = output->data.int8[0];
   // Dequantize the output from integer to floating-point
@@ -122,3 +171,152 @@ float loop(float x_value) {
 
   return y;
 }
+
+// Copies the quantized output tensor and its parameters.
+static int copy_quantized_output(QuantizedOutput* out) {
+  if (output->type != kTfLiteInt8 || output->bytes > out->size ||
+      output->dims->size > QUANTIZED_OUTPUT_MAX_DIMS) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Unsupported output tensor");
+    return -1;
+  }
+
+  // Hand the output over without dequantizing it, the consumer applies the
+  // scale and zero point.
+  memcpy(out->data, output->data.int8, output->bytes);
+  out->size = output->bytes;
+  out->dims_len = output->dims->size;
+  for (int i = 0; i < output->dims->size; i++) {
+    out->dims[i] = output->dims->data[i];
+  }
+  out->scale = output->params.scale;
+  out->zero_point = output->params.zero_point;
+
+  return 0;
+}
+
+// The name of this function is important for Arduino compatibility.
+int loop(float x_value, float* y_value) {
+  quantize_input(x_value);
+  if (invoke() != kTfLiteOk) {
+    return -1;
+  }
+
+  *y_value = dequantize_output();
+  return 0;
+}
+
+int loop_quantized(float x_value, QuantizedOutput* out) {
+  quantize_input(x_value);
+  if (invoke() != kTfLiteOk) {
+    return -1;
+  }
+
+  return copy_quantized_output(out);
+}
+
+int input_params(float* scale, int32_t* zero_point, size_t* count) {
+  if (input == nullptr || input->type != kTfLiteInt8) {
+    return -1;
+  }
+
+  *scale = input->params.scale;
+  *zero_point = input->params.zero_point;
+  *count = input->bytes;
+
+  return 0;
+}
+
+int load_input(const int8_t* data, size_t count) {
+  if (input == nullptr || count != input->bytes) {
+    return -1;
+  }
+
+  memcpy(input->data.int8, data, count);
+
+  return 0;
+}
+
+int loop_loaded(float* y_value) {
+  if (invoke() != kTfLiteOk) {
+    return -1;
+  }
+
+  *y_value = dequantize_output();
+  return 0;
+}
+
+int loop_loaded_quantized(QuantizedOutput* out) {
+  if (invoke() != kTfLiteOk) {
+    return -1;
+  }
+
+  return copy_quantized_output(out);
+}
+
+// Calls fn with the data and size of every variable tensor of the model.
+template <typename Fn>
+static int for_each_variable(Fn fn) {
+  if (interpreter == nullptr) {
+    return -1;
+  }
+
+  const auto* tensors = model->subgraphs()->Get(0)->tensors();
+  for (size_t i = 0; i < tensors->size(); i++) {
+    if (!tensors->Get(i)->is_variable()) {
+      continue;
+    }
+
+    TfLiteEvalTensor* tensor = interpreter->eval_tensor(i);
+    size_t bytes;
+    if (tflite::TfLiteEvalTensorByteLength(tensor, &bytes) != kTfLiteOk ||
+        fn(tensor->data.raw, bytes) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+size_t state_size() {
+  size_t total = 0;
+
+  for_each_variable([&total](char*, size_t bytes) {
+    total += bytes;
+    return 0;
+  });
+
+  return total;
+}
+
+int save_state(uint8_t* buf, size_t size) {
+  return for_each_variable([&buf, &size](char* data, size_t bytes) {
+    if (bytes > size) {
+      return -1;
+    }
+    memcpy(buf, data, bytes);
+    buf += bytes;
+    size -= bytes;
+    return 0;
+  });
+}
+
+int restore_state(const uint8_t* buf, size_t size) {
+  return for_each_variable([&buf, &size](char* data, size_t bytes) {
+    if (bytes > size) {
+      return -1;
+    }
+    memcpy(data, buf, bytes);
+    buf += bytes;
+    size -= bytes;
+    return 0;
+  });
+}
+
+int reset_state() {
+  if (interpreter == nullptr ||
+      interpreter->ResetVariableTensors() != kTfLiteOk) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -16,19 +16,83 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_HELLO_WORLD_MAIN_FUNCTIONS_H_
 #define TENSORFLOW_LITE_MICRO_EXAMPLES_HELLO_WORLD_MAIN_FUNCTIONS_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 // Expose a C friendly interface for main functions.
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Initializes all data needed for the example. The name is important, and needs
-// to be setup() for Arduino compatibility.
-void setup();
+// Minimum tensor arena size in bytes required by the hello_world model.
+#define HELLO_WORLD_TENSOR_ARENA_SIZE 2000
+
+// Initializes all data needed for the example using the supplied tensor arena,
+// which must stay valid until teardown() is called. Calling setup() again
+// rebuilds the interpreter on the new arena. Returns 0 on success. The name is
+// important, and needs to be setup() for Arduino compatibility.
+int setup(uint8_t* tensor_arena, size_t tensor_arena_size);
+
+// Releases the interpreter so that the tensor arena passed to setup() can be
+// handed over to another model.
+void teardown();
+
+// Drops the interpreter without running its destructor, for when the tensor
+// arena passed to setup() has already been overwritten by someone else.
+void discard();
 
 // Runs one iteration of data gathering and inference. This should be called
 // repeatedly from the application code. The name needs to be loop() for Arduino
-// compatibility.
-float loop(float x_value);
+// compatibility. Returns 0 on success and stores the output in y_value.
+int loop(float x_value, float* y_value);
+
+// Maximum number of dimensions of the output tensor returned by
+// loop_quantized().
+#define QUANTIZED_OUTPUT_MAX_DIMS 4
+
+// Raw int8 output tensor of the model, with the parameters needed to
+// dequantize it.
+typedef struct {
+  int8_t* data;        // Caller supplied buffer for the output tensor.
+  size_t size;         // Size of data, updated to the bytes written.
+  uint32_t dims[QUANTIZED_OUTPUT_MAX_DIMS];  // Output tensor shape.
+  size_t dims_len;     // Number of entries in dims.
+  float scale;         // Quantization scale.
+  int32_t zero_point;  // Quantization zero point.
+} QuantizedOutput;
+
+// Runs one inference like loop(), but returns the quantized output tensor as
+// is instead of dequantizing it. Returns 0 on success.
+int loop_quantized(float x_value, QuantizedOutput* out);
+
+// Returns the quantization parameters and the number of elements of the
+// model's input tensor, so that callers can quantize inputs themselves.
+// Returns 0 on success.
+int input_params(float* scale, int32_t* zero_point, size_t* count);
+
+// Copies an already quantized input of count elements into the model's input
+// tensor. Returns 0 on success.
+int load_input(const int8_t* data, size_t count);
+
+// Same as loop() and loop_quantized(), but run on the input set by
+// load_input(). Both return 0 on success, loop_loaded() stores the
+// dequantized output in y_value.
+int loop_loaded(float* y_value);
+int loop_loaded_quantized(QuantizedOutput* out);
+
+// Clears the variable tensors of stateful models, such as the history kept by
+// circular buffer and SVDF operators, so that the next inference starts a new
+// stream. Returns 0 on success.
+int reset_state();
+
+// Returns the number of bytes held by the variable tensors of the model.
+size_t state_size();
+
+// Copies the variable tensors out to, or back in from, a buffer of at least
+// state_size() bytes, so that several streams can share one interpreter.
+// Returns 0 on success.
+int save_state(uint8_t* buf, size_t size);
+int restore_state(const uint8_t* buf, size_t size);
 
 #ifdef __cplusplus
 }
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -24,6 +25,7 @@
 #endif
 
 #include "main_functions.h"
+#include "sp_workspace.h"
 
 #define SERV_NAME "TFLM SERVICE"
 
@@ -45,11 +47,96 @@ typedef struct {
 	char tflm_model_version[TFLM_VERSION_BUFF_SIZE];        /* md5sum tflite model calculated value */
 } tflm_model_version_t;
 
+/* Entry points used to bring a model in and out of a tensor arena slot. */
+typedef struct {
+	size_t arena_size;                              /* Tensor arena bytes needed by the model */
+	int (*init)(uint8_t *arena, size_t arena_size); /* Build the interpreter on the arena */
+	void (*deinit)(void);                           /* Release the arena */
+	void (*discard)(void);                          /* Drop the interpreter of */
+							/* an arena already reused */
+	int (*run)(float x_value, float *y_value);      /* Run a single inference */
+	int (*run_quantized)(float x_value,             /* Run a single inference, */
+			     QuantizedOutput *out);     /* keeping the int8 output */
+	int (*input_params)(float *scale,               /* Input tensor quantization */
+			    int32_t *zero_point,        /* parameters and element */
+			    size_t *count);             /* count */
+	int (*load_input)(const int8_t *data,           /* Copy a quantized input */
+			  size_t count);                /* into the input tensor */
+	int (*run_loaded)(float *y_value);              /* run() on the loaded input */
+	int (*run_loaded_quantized)(QuantizedOutput *out); /* run_quantized() on the */
+							   /* loaded input */
+	int (*reset_state)(void);                       /* Clear variable tensors */
+	size_t (*state_size)(void);                     /* Variable tensor bytes */
+	int (*save_state)(uint8_t *buf, size_t size);   /* Copy variable tensors out */
+	int (*restore_state)(const uint8_t *buf,        /* Copy variable tensors */
+			     size_t size);              /* back in */
+} tflm_model_ops_t;
+
+/* Runtime state of a model, only valid while the model is resident. */
+typedef struct {
+	_Bool is_resident;      /* Model is initialised in an arena slot */
+	uint8_t slot;           /* Arena slot index owned by the model */
+	uint32_t last_used;     /* LRU timestamp of the last acquire */
+} tflm_model_state_t;
+
 typedef struct {
 	huk_enc_format_t enc_format;
 	char model[32];
+	huk_out_format_t out_format;
 } tflm_config_t;
 
+/* Header of one chunk of an input tensor upload, offset and total are in
+ * elements of the float input.
+ */
+typedef struct {
+	char model[32];
+	uint32_t slot;
+	uint32_t offset;
+	uint32_t total;
+} tflm_input_chunk_t;
+
+typedef enum {
+	TFLM_INPUT_SLOT_EMPTY = 0,      /* Nothing staged */
+	TFLM_INPUT_SLOT_FILLING,        /* Upload in progress */
+	TFLM_INPUT_SLOT_READY,          /* Complete input, waiting for inference */
+} tflm_input_slot_state_t;
+
+typedef enum {
+	TFLM_STREAM_OPEN = 0,           /* Reset the model state, start a stream */
+	TFLM_STREAM_PUSH,               /* Run the model on the next frames */
+	TFLM_STREAM_CLOSE,              /* End the stream */
+} tflm_stream_op_t;
+
+/* Header of a streaming session request, cfg is only used on open. */
+typedef struct {
+	uint32_t op;
+	tflm_config_t cfg;
+} tflm_stream_req_t;
+
+/* Per-client state, allocated on PSA_IPC_CONNECT to one of the
+ * TFLM_SESSION_SIGNALS services and bound to the connection's rhandle. It
+ * caches the last validated inference config and,
+ * while a stream is open, keeps the stream's variable tensors whenever they
+ * are not live in the model.
+ */
+typedef struct {
+	_Bool in_use;
+	_Bool has_config;               /* cfg and model were validated */
+	tflm_config_t cfg;
+	tflm_model_idx_t model;
+	_Bool stream_open;
+	size_t state_len;               /* Variable tensor bytes of the model */
+	uint8_t state[TFLM_SESSION_STATE_SIZE];
+} tflm_session_t;
+
+/* An input tensor staged in its quantized form. */
+typedef struct {
+	tflm_input_slot_state_t state;
+	tflm_model_idx_t model;         /* Model the input was quantized for */
+	uint32_t filled;                /* Elements received so far */
+	int8_t data[TFLM_INPUT_SLOT_SIZE];
+} tflm_input_slot_t;
+
 /* Example exported GitHub commit ID is used as a TFLM version because of tflite-micro source
  * (where examples exported) did not have any version attributes.
  */
@@ -62,6 +149,65 @@ static const char tflm_version[TFLM_VERSION_BUFF_SIZE] =
 static const tflm_model_version_t tflm_model_version[TFLM_MODEL_COUNT] =
 { { "TFLM_MODEL_SINE", "27036dd122bc82da54fc0f2d7d99497b" } };
 
+static const tflm_model_ops_t tflm_model_ops[TFLM_MODEL_COUNT] = {
+	{ HELLO_WORLD_TENSOR_ARENA_SIZE, setup, teardown, discard, loop,
+	  loop_quantized,
+	  input_params, load_input, loop_loaded, loop_loaded_quantized,
+	  reset_state, state_size, save_state, restore_state },
+};
+
+/* Models are initialised on first use into one of the tensor arena slots
+ * below, rather than at partition start. When every slot is taken, the least
+ * recently used model is torn down to make room, so the pool only has to be
+ * sized for the models that are expected to be hot at the same time.
+ *
+ * The slots are carved out of the secure workspace shared with the UTVM
+ * partition. If UTVM claims it in between two TFLM requests, which the
+ * workspace generation tells on the next acquire, every resident model is
+ * dropped and initialised again on its next use.
+ */
+#define TFLM_ARENA_POOL_SLOTS   1
+#define TFLM_ARENA_SLOT_SIZE    ((HELLO_WORLD_TENSOR_ARENA_SIZE + 15) & ~15)
+#define TFLM_ARENA_POOL_SIZE    (TFLM_ARENA_POOL_SLOTS * TFLM_ARENA_SLOT_SIZE)
+
+static uint8_t *tflm_arena_pool;
+
+/* Shared workspace generation the resident models were initialised at. */
+static uint32_t tflm_arena_generation;
+
+/* Model index currently owning each arena slot, TFLM_MODEL_COUNT if free. */
+static tflm_model_idx_t tflm_arena_owner[TFLM_ARENA_POOL_SLOTS];
+
+static tflm_model_state_t tflm_model_state[TFLM_MODEL_COUNT];
+static uint32_t tflm_lru_clock;
+
+/* Output tensor of the quantized output mode, kept off the partition stack. */
+static int8_t tflm_quantized_out[HUK_TENSOR_MAX_SIZE];
+
+/* Input tensors are uploaded in chunks into one of the staging slots below
+ * and quantized on the fly, so the float tensor never has to fit in secure
+ * memory. With two slots, the NS side can upload frame N+1 while frame N is
+ * still waiting for, or going through, inference.
+ */
+static tflm_input_slot_t tflm_input_slot[TFLM_INPUT_SLOTS];
+
+/* Samples of a streaming session are pushed through the model one input frame
+ * at a time, so that the variable tensors carry the history between frames
+ * instead of full windows being recomputed.
+ */
+static int8_t tflm_stream_frame[TFLM_INPUT_SLOT_SIZE];
+
+static tflm_session_t tflm_session[TFLM_SESSION_MAX];
+
+/* Services that keep per-client state. The others are stateless, so their
+ * connections don't take a session from the pool.
+ */
+#define TFLM_SESSION_SIGNALS (TFM_TFLM_SERVICE_HELLO_SIGNAL | \
+			      TFM_TFLM_STREAM_SERVICE_SIGNAL)
+
+/* Session whose stream state is live in each model's variable tensors. */
+static tflm_session_t *tflm_state_owner[TFLM_MODEL_COUNT];
+
 // /* I2C driver name for LSM303 peripheral */
 // extern ARM_DRIVER_I2C LSM303_DRIVER;
 
@@ -207,17 +353,422 @@ static const tflm_model_version_t tflm_model_version[TFLM_MODEL_COUNT] =
 //     psa_reply(msg.handle, status);
 // }
 
+static psa_status_t tfm_tflm_model_find(const char *model,
+					tflm_model_idx_t *idx)
+{
+	for (int i = 0; i < TFLM_MODEL_COUNT; i++) {
+		if (strcmp(tflm_model_version[i].tflm_model, model) == 0) {
+			*idx = i;
+			return PSA_SUCCESS;
+		}
+	}
+
+	return PSA_ERROR_NOT_SUPPORTED;
+}
+
+/**
+ * \brief Save the live variable tensors of a model into the session they
+ * belong to, before the model is used by another client or torn down.
+ */
+static void tfm_tflm_state_park(tflm_model_idx_t idx)
+{
+	tflm_session_t *owner = tflm_state_owner[idx];
+
+	if (owner == NULL) {
+		return;
+	}
+
+	if (tflm_model_ops[idx].save_state(owner->state,
+					   sizeof(owner->state)) != 0) {
+		log_err_print("%s stream state was lost",
+			      tflm_model_version[idx].tflm_model);
+		owner->stream_open = false;
+	}
+	tflm_state_owner[idx] = NULL;
+}
+
+/**
+ * \brief Make the variable tensors of a session's stream live in its model,
+ * parking those of the previous owner.
+ */
+static psa_status_t tfm_tflm_state_bind(tflm_session_t *session)
+{
+	tflm_model_idx_t idx = session->model;
+
+	if (tflm_state_owner[idx] == session) {
+		return PSA_SUCCESS;
+	}
+
+	tfm_tflm_state_park(idx);
+	if (tflm_model_ops[idx].restore_state(session->state,
+					      session->state_len) != 0) {
+		session->stream_open = false;
+		return PSA_ERROR_BAD_STATE;
+	}
+	tflm_state_owner[idx] = session;
+
+	return PSA_SUCCESS;
+}
+
+static tflm_session_t *tfm_tflm_session_alloc(void)
+{
+	for (int i = 0; i < TFLM_SESSION_MAX; i++) {
+		if (!tflm_session[i].in_use) {
+			memset(&tflm_session[i], 0, sizeof(tflm_session[i]));
+			tflm_session[i].in_use = true;
+			return &tflm_session[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void tfm_tflm_stream_close(tflm_session_t *session)
+{
+	if (session->stream_open &&
+	    tflm_state_owner[session->model] == session) {
+		tflm_state_owner[session->model] = NULL;
+	}
+	session->stream_open = false;
+}
+
+static void tfm_tflm_session_free(tflm_session_t *session)
+{
+	if (session == NULL) {
+		return;
+	}
+
+	tfm_tflm_stream_close(session);
+	session->in_use = false;
+}
+
+/**
+ * \brief Validate an inference config and select its model, unless it is the
+ * config the session validated last.
+ */
+static psa_status_t tfm_tflm_session_config(tflm_session_t *session,
+					    const tflm_config_t *cfg)
+{
+	psa_status_t status;
+	tflm_model_idx_t idx;
+
+	if (session->has_config &&
+	    memcmp(&session->cfg, cfg, sizeof(*cfg)) == 0) {
+		return PSA_SUCCESS;
+	}
+
+	status = tfm_tflm_model_find(cfg->model, &idx);
+	if (status != PSA_SUCCESS) {
+		log_err_print("%s model is not supported", cfg->model);
+		return status;
+	}
+
+	if (cfg->out_format != HUK_OUT_FLOAT &&
+	    cfg->out_format != HUK_OUT_INT8) {
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	memcpy(&session->cfg, cfg, sizeof(*cfg));
+	session->model = idx;
+	session->has_config = true;
+
+	return PSA_SUCCESS;
+}
+
+static void tfm_tflm_arena_pool_init(void)
+{
+	for (int i = 0; i < TFLM_ARENA_POOL_SLOTS; i++) {
+		tflm_arena_owner[i] = TFLM_MODEL_COUNT;
+	}
+}
+
+/**
+ * \brief Forget every resident model after the shared workspace was used by
+ * another engine. The arena contents are gone by now, so the interpreters are
+ * discarded rather than torn down, and a stream whose variable tensors were
+ * live in the arena is closed.
+ */
+static void tfm_tflm_arena_pool_drop(void)
+{
+	tflm_model_idx_t owner;
+	tflm_session_t *session;
+
+	for (int i = 0; i < TFLM_ARENA_POOL_SLOTS; i++) {
+		owner = tflm_arena_owner[i];
+		if (owner == TFLM_MODEL_COUNT) {
+			continue;
+		}
+		session = tflm_state_owner[owner];
+		if (session != NULL) {
+			log_err_print("%s stream state was lost",
+				      tflm_model_version[owner].tflm_model);
+			session->stream_open = false;
+			tflm_state_owner[owner] = NULL;
+		}
+		tflm_model_ops[owner].discard();
+		tflm_model_state[owner].is_resident = false;
+		tflm_arena_owner[i] = TFLM_MODEL_COUNT;
+	}
+}
+
+/* Pick a free arena slot, or evict the least recently used model. */
+static uint8_t tfm_tflm_arena_slot_get(void)
+{
+	uint8_t victim = 0;
+	uint32_t oldest = UINT32_MAX;
+	tflm_model_idx_t owner;
+
+	for (int i = 0; i < TFLM_ARENA_POOL_SLOTS; i++) {
+		owner = tflm_arena_owner[i];
+		if (owner == TFLM_MODEL_COUNT) {
+			return i;
+		}
+		if (tflm_model_state[owner].last_used < oldest) {
+			oldest = tflm_model_state[owner].last_used;
+			victim = i;
+		}
+	}
+
+	owner = tflm_arena_owner[victim];
+	log_info_print("Evicting %s", tflm_model_version[owner].tflm_model);
+	tfm_tflm_state_park(owner);
+	tflm_model_ops[owner].deinit();
+	tflm_model_state[owner].is_resident = false;
+	tflm_arena_owner[victim] = TFLM_MODEL_COUNT;
+
+	return victim;
+}
+
+/**
+ * \brief Make sure the given model is initialised in an arena slot, loading
+ * it on first use, and mark it as the most recently used model.
+ */
+static psa_status_t tfm_tflm_model_acquire(tflm_model_idx_t idx)
+{
+	tflm_model_state_t *state = &tflm_model_state[idx];
+	const tflm_model_ops_t *ops = &tflm_model_ops[idx];
+	psa_status_t status;
+	uint32_t generation;
+	uint8_t slot;
+
+	status = sp_workspace_acquire(SP_WORKSPACE_OWNER_TFLM,
+				      TFLM_ARENA_POOL_SIZE,
+				      &tflm_arena_pool,
+				      &generation);
+	if (status != PSA_SUCCESS) {
+		return status;
+	}
+
+	if (generation != tflm_arena_generation) {
+		tfm_tflm_arena_pool_drop();
+		tflm_arena_generation = generation;
+	}
+
+	if (!state->is_resident) {
+		if (ops->arena_size > TFLM_ARENA_SLOT_SIZE) {
+			log_err_print("%s needs %d arena bytes",
+				      tflm_model_version[idx].tflm_model,
+				      (int)ops->arena_size);
+			return PSA_ERROR_INSUFFICIENT_MEMORY;
+		}
+
+		slot = tfm_tflm_arena_slot_get();
+		if (ops->init(tflm_arena_pool + slot * TFLM_ARENA_SLOT_SIZE,
+			      TFLM_ARENA_SLOT_SIZE) != 0) {
+			log_err_print("%s initialisation failed",
+				      tflm_model_version[idx].tflm_model);
+			return PSA_ERROR_GENERIC_ERROR;
+		}
+
+		tflm_arena_owner[slot] = idx;
+		state->slot = slot;
+		state->is_resident = true;
+		log_info_print("%s initialised in arena slot %d",
+			       tflm_model_version[idx].tflm_model, slot);
+	}
+
+	state->last_used = ++tflm_lru_clock;
+
+	return PSA_SUCCESS;
+}
+
+/**
+ * \brief Run inference and sign the raw int8 output tensor, along with its
+ * scale and zero point, instead of dequantizing it to float. A NULL x_value
+ * runs the model on the input already loaded in its input tensor.
+ */
+static psa_status_t tfm_tflm_infer_run_quantized(tflm_model_idx_t idx,
+						 const float *x_value,
+						 huk_enc_format_t enc_format,
+						 uint8_t *encoded_buf,
+						 size_t encoded_buf_size,
+						 size_t *encoded_buf_len)
+{
+	QuantizedOutput out = {
+		.data = tflm_quantized_out,
+		.size = sizeof(tflm_quantized_out),
+	};
+	huk_tensor_desc_t desc = { .type = HUK_TENSOR_INT8 };
+
+	const tflm_model_ops_t *ops = &tflm_model_ops[idx];
+	int ret;
+
+	ret = x_value ? ops->run_quantized(*x_value, &out) :
+	      ops->run_loaded_quantized(&out);
+	if (ret != 0 || out.dims_len > HUK_TENSOR_MAX_DIMS) {
+		log_err_print("%s quantized inference failed",
+			      tflm_model_version[idx].tflm_model);
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+
+	desc.dims_len = out.dims_len;
+	for (size_t i = 0; i < out.dims_len; i++) {
+		desc.dims[i] = out.dims[i];
+	}
+	desc.scale = out.scale;
+	desc.zero_point = out.zero_point;
+
+	log_info_print("Starting CBOR/COSE encoding");
+	return psa_huk_cose_sign_tensor(&desc,
+					tflm_quantized_out,
+					out.size,
+					enc_format,
+					encoded_buf,
+					encoded_buf_size,
+					encoded_buf_len);
+}
+
+/**
+ * \brief Run inference, either on x_value or, if NULL, on the input already
+ * loaded in the model's input tensor, and encode and sign the output.
+ */
+static psa_status_t tfm_tflm_infer_encode(tflm_model_idx_t idx,
+					  const float *x_value,
+					  huk_enc_format_t enc_format,
+					  huk_out_format_t out_format,
+					  uint8_t *encoded_buf,
+					  size_t encoded_buf_size,
+					  size_t *encoded_buf_len)
+{
+	float y_value;
+
+	if (out_format == HUK_OUT_INT8) {
+		return tfm_tflm_infer_run_quantized(idx,
+						    x_value,
+						    enc_format,
+						    encoded_buf,
+						    encoded_buf_size,
+						    encoded_buf_len);
+	} else if (out_format != HUK_OUT_FLOAT) {
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	if (x_value ? tflm_model_ops[idx].run(*x_value, &y_value) != 0 :
+	    tflm_model_ops[idx].run_loaded(&y_value) != 0) {
+		log_err_print("%s inference failed",
+			      tflm_model_version[idx].tflm_model);
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+
+	log_info_print("Starting CBOR/COSE encoding");
+	return psa_huk_cose_sign(&y_value,
+				 enc_format,
+				 encoded_buf,
+				 encoded_buf_size,
+				 encoded_buf_len);
+}
+
+/**
+ * \brief Quantize a block of float input values into a staging slot.
+ */
+static void tfm_tflm_input_quantize(int8_t *dst,
+				    const float *src,
+				    size_t count,
+				    float scale,
+				    int32_t zero_point)
+{
+	int32_t q;
+
+	for (size_t i = 0; i < count; i++) {
+		q = (int32_t)(src[i] / scale) + zero_point;
+		if (q < INT8_MIN) {
+			q = INT8_MIN;
+		} else if (q > INT8_MAX) {
+			q = INT8_MAX;
+		}
+		dst[i] = (int8_t)q;
+	}
+}
+
+/**
+ * \brief Read count float values from an invec, TFLM_INPUT_READ_BLOCK at a
+ * time, and quantize them into dst.
+ */
+static psa_status_t tfm_tflm_input_read(psa_msg_t *msg,
+					uint32_t invec_idx,
+					int8_t *dst,
+					size_t count,
+					float scale,
+					int32_t zero_point)
+{
+	float block[TFLM_INPUT_READ_BLOCK];
+	size_t n;
+
+	while (count > 0) {
+		n = count < TFLM_INPUT_READ_BLOCK ? count : TFLM_INPUT_READ_BLOCK;
+		if (psa_read(msg->handle, invec_idx, block, n * sizeof(float)) !=
+		    n * sizeof(float)) {
+			return PSA_ERROR_COMMUNICATION_FAILURE;
+		}
+		tfm_tflm_input_quantize(dst, block, n, scale, zero_point);
+		dst += n;
+		count -= n;
+	}
+
+	return PSA_SUCCESS;
+}
+
+/**
+ * \brief Load a staged input into the model's input tensor and release the
+ * staging slot, so that the next frame can be uploaded into it.
+ */
+static psa_status_t tfm_tflm_input_load(tflm_model_idx_t idx, uint32_t slot)
+{
+	tflm_input_slot_t *in;
+	psa_status_t status = PSA_SUCCESS;
+
+	if (slot >= TFLM_INPUT_SLOTS) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	in = &tflm_input_slot[slot];
+	if (in->state != TFLM_INPUT_SLOT_READY || in->model != idx) {
+		log_err_print("input slot %d is not ready", (int)slot);
+		return PSA_ERROR_BAD_STATE;
+	}
+
+	if (tflm_model_ops[idx].load_input(in->data, in->filled) != 0) {
+		status = PSA_ERROR_GENERIC_ERROR;
+	}
+	in->state = TFLM_INPUT_SLOT_EMPTY;
+
+	return status;
+}
+
 /**
  * \brief Run inference using Tensorflow lite-micro
  */
 psa_status_t tfm_tflm_infer_run(psa_msg_t *msg)
 {
 	psa_status_t status = PSA_SUCCESS;
-	float x_value, y_value;
+	tflm_session_t *session = msg->rhandle;
+	float x_value;
 	uint8_t inf_val_encoded_buf[msg->out_size[0]];
 	size_t inf_val_encoded_buf_len = 0;
 	tflm_config_t cfg;
-	_Bool is_model_supported = false;
+	tflm_model_idx_t idx;
+	uint32_t slot;
+	_Bool from_slot = false;
 
 	// Check size of invec/outvec parameter
 	if (msg->in_size[1] != sizeof(tflm_config_t)) {
@@ -226,42 +777,67 @@ psa_status_t tfm_tflm_infer_run(psa_msg_t *msg)
 		goto err;
 	}
 
-	psa_read(msg->handle, 0, &x_value, msg->in_size[0]);
 	psa_read(msg->handle, 1, &cfg, sizeof(tflm_config_t));
+	cfg.model[sizeof(cfg.model) - 1] = '\0';
 
-	for (int i = 0; i < TFLM_MODEL_COUNT; i++) {
-		if (strcmp(tflm_model_version[i].tflm_model, cfg.model) == 0) {
-			is_model_supported = true;
-			break;
-		}
+	/* An optional third invec selects an uploaded input slot, in which
+	 * case invec 0 is ignored.
+	 */
+	if (msg->in_size[2] == sizeof(slot)) {
+		psa_read(msg->handle, 2, &slot, sizeof(slot));
+		from_slot = true;
+	} else if (msg->in_size[0] == sizeof(x_value)) {
+		psa_read(msg->handle, 0, &x_value, sizeof(x_value));
+	} else {
+		status = PSA_ERROR_PROGRAMMER_ERROR;
+		goto err;
 	}
 
-	if (!is_model_supported) {
-		log_err_print("%s model is not supported", cfg.model);
-		status = PSA_ERROR_NOT_SUPPORTED;
+	status = tfm_tflm_session_config(session, &cfg);
+	if (status != PSA_SUCCESS) {
 		goto err;
 	}
-
+	idx = session->model;
 
 	/* This constant kXrange represents the range of x values our model
 	 * was trained on, which is from 0 to (2 * Pi). We approximate Pi
 	 * to avoid requiring additional libraries.
 	 */
-	if ((kXrange < x_value) || (x_value < 0.0f)) {
+	if (!from_slot && ((kXrange < x_value) || (x_value < 0.0f))) {
 		status = PSA_ERROR_PROGRAMMER_ERROR;
 		goto err;
 	}
 
+	status = tfm_tflm_model_acquire(idx);
+	if (status != PSA_SUCCESS) {
+		goto err;
+	}
+
+	/* One-shot inferences start from clear variable tensors, any stream
+	 * state is parked in its session first.
+	 */
+	tfm_tflm_state_park(idx);
+	if (tflm_model_ops[idx].reset_state() != 0) {
+		status = PSA_ERROR_GENERIC_ERROR;
+		goto err;
+	}
+
+	if (from_slot) {
+		status = tfm_tflm_input_load(idx, slot);
+		if (status != PSA_SUCCESS) {
+			goto err;
+		}
+	}
+
 	/* Run inference */
 	log_info_print("Starting secure inferencing");
-	y_value = loop(x_value);
-
-	log_info_print("Starting CBOR/COSE encoding");
-	status = psa_huk_cose_sign(&y_value,
-				   cfg.enc_format,
-				   inf_val_encoded_buf,
-				   msg->out_size[0],
-				   &inf_val_encoded_buf_len);
+	status = tfm_tflm_infer_encode(idx,
+				       from_slot ? NULL : &x_value,
+				       cfg.enc_format,
+				       cfg.out_format,
+				       inf_val_encoded_buf,
+				       msg->out_size[0],
+				       &inf_val_encoded_buf_len);
 	if (status != PSA_SUCCESS) {
 		log_err_print("failed with %d", status);
 		goto err;
@@ -280,12 +856,315 @@ err:
 	return status;
 }
 
+/**
+ * \brief Receive one chunk of an input tensor into a staging slot.
+ *
+ * invec 0 carries a tflm_input_chunk_t header and invec 1 the float values.
+ * The values are read in blocks and quantized with the model's input
+ * parameters as they arrive. Chunks must be sent in order, a chunk at offset
+ * 0 restarts the slot, and the slot is ready for inference once total
+ * elements have been received.
+ */
+psa_status_t tfm_tflm_input_upload(psa_msg_t *msg)
+{
+	psa_status_t status = PSA_SUCCESS;
+	tflm_input_chunk_t hdr;
+	tflm_input_slot_t *in;
+	tflm_model_idx_t idx;
+	float scale;
+	int32_t zero_point;
+	size_t count, remaining;
+
+	/* Check size of invec parameters */
+	if (msg->in_size[0] != sizeof(hdr) ||
+	    msg->in_size[1] % sizeof(float) != 0) {
+		status = PSA_ERROR_PROGRAMMER_ERROR;
+		goto err;
+	}
+
+	psa_read(msg->handle, 0, &hdr, sizeof(hdr));
+	hdr.model[sizeof(hdr.model) - 1] = '\0';
+	if (hdr.slot >= TFLM_INPUT_SLOTS) {
+		status = PSA_ERROR_INVALID_ARGUMENT;
+		goto err;
+	}
+
+	status = tfm_tflm_model_find(hdr.model, &idx);
+	if (status != PSA_SUCCESS) {
+		log_err_print("%s model is not supported", hdr.model);
+		goto err;
+	}
+
+	status = tfm_tflm_model_acquire(idx);
+	if (status != PSA_SUCCESS) {
+		goto err;
+	}
+
+	if (tflm_model_ops[idx].input_params(&scale, &zero_point, &count) != 0) {
+		status = PSA_ERROR_NOT_SUPPORTED;
+		goto err;
+	}
+
+	remaining = msg->in_size[1] / sizeof(float);
+	if (hdr.total != count || count > TFLM_INPUT_SLOT_SIZE ||
+	    hdr.offset > count || remaining > count - hdr.offset) {
+		status = PSA_ERROR_INVALID_ARGUMENT;
+		goto err;
+	}
+
+	in = &tflm_input_slot[hdr.slot];
+	if (hdr.offset == 0) {
+		in->state = TFLM_INPUT_SLOT_FILLING;
+		in->model = idx;
+		in->filled = 0;
+	}
+	if (in->state != TFLM_INPUT_SLOT_FILLING || in->model != idx ||
+	    in->filled != hdr.offset) {
+		status = PSA_ERROR_BAD_STATE;
+		goto err;
+	}
+
+	status = tfm_tflm_input_read(msg, 1, &in->data[in->filled], remaining,
+				     scale, zero_point);
+	if (status != PSA_SUCCESS) {
+		in->state = TFLM_INPUT_SLOT_EMPTY;
+		goto err;
+	}
+
+	in->filled += remaining;
+	if (in->filled == count) {
+		in->state = TFLM_INPUT_SLOT_READY;
+	}
+err:
+	return status;
+}
+
+/**
+ * \brief Start a streaming session on a model, clearing its variable tensors.
+ */
+static psa_status_t tfm_tflm_stream_open(tflm_session_t *session,
+					 const tflm_config_t *cfg)
+{
+	psa_status_t status;
+	tflm_model_idx_t idx;
+
+	tfm_tflm_stream_close(session);
+
+	status = tfm_tflm_session_config(session, cfg);
+	if (status != PSA_SUCCESS) {
+		return status;
+	}
+	idx = session->model;
+
+	status = tfm_tflm_model_acquire(idx);
+	if (status != PSA_SUCCESS) {
+		return status;
+	}
+
+	session->state_len = tflm_model_ops[idx].state_size();
+	if (session->state_len > sizeof(session->state)) {
+		log_err_print("%s needs %d state bytes",
+			      tflm_model_version[idx].tflm_model,
+			      (int)session->state_len);
+		return PSA_ERROR_INSUFFICIENT_MEMORY;
+	}
+
+	tfm_tflm_state_park(idx);
+	if (tflm_model_ops[idx].reset_state() != 0) {
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+
+	tflm_state_owner[idx] = session;
+	session->stream_open = true;
+
+	return PSA_SUCCESS;
+}
+
+/**
+ * \brief End a stream whose push failed part way, so that the next push does
+ * not carry on from a history that only saw some of the frames.
+ */
+static void tfm_tflm_stream_abort(tflm_session_t *session)
+{
+	tflm_model_idx_t idx = session->model;
+
+	log_err_print("%s stream was reset", tflm_model_version[idx].tflm_model);
+	if (tflm_state_owner[idx] == session) {
+		tflm_model_ops[idx].reset_state();
+	}
+	tfm_tflm_stream_close(session);
+}
+
+/**
+ * \brief Run the streaming model on every input frame pushed in invec 1, and
+ * return the signed output of the last frame. On failure, the stream is
+ * closed and has to be opened again.
+ */
+static psa_status_t tfm_tflm_stream_push(tflm_session_t *session,
+					 psa_msg_t *msg)
+{
+	psa_status_t status;
+	tflm_model_idx_t idx = session->model;
+	const tflm_model_ops_t *ops = &tflm_model_ops[idx];
+	uint8_t inf_val_encoded_buf[msg->out_size[0]];
+	size_t inf_val_encoded_buf_len = 0;
+	float scale, y_value;
+	int32_t zero_point;
+	size_t frame, frames;
+
+	if (!session->stream_open) {
+		return PSA_ERROR_BAD_STATE;
+	}
+
+	status = tfm_tflm_model_acquire(idx);
+	if (status != PSA_SUCCESS) {
+		return status;
+	}
+
+	/* The stream is closed if its history was lost with the workspace */
+	if (!session->stream_open) {
+		return PSA_ERROR_BAD_STATE;
+	}
+
+	/* Bring the stream's history back if another client used the model, or
+	 * it was evicted, since the last push.
+	 */
+	status = tfm_tflm_state_bind(session);
+	if (status != PSA_SUCCESS) {
+		log_err_print("%s stream state was lost",
+			      tflm_model_version[idx].tflm_model);
+		return status;
+	}
+
+	if (ops->input_params(&scale, &zero_point, &frame) != 0 ||
+	    frame > sizeof(tflm_stream_frame)) {
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	if (msg->in_size[1] == 0 ||
+	    msg->in_size[1] % (frame * sizeof(float)) != 0) {
+		return PSA_ERROR_INVALID_ARGUMENT;
+	}
+
+	for (frames = msg->in_size[1] / (frame * sizeof(float));
+	     frames > 0; frames--) {
+		status = tfm_tflm_input_read(msg, 1, tflm_stream_frame, frame,
+					     scale, zero_point);
+		if (status != PSA_SUCCESS) {
+			tfm_tflm_stream_abort(session);
+			return status;
+		}
+		if (ops->load_input(tflm_stream_frame, frame) != 0) {
+			tfm_tflm_stream_abort(session);
+			return PSA_ERROR_GENERIC_ERROR;
+		}
+		/* Only advance the model state */
+		if (frames > 1 && ops->run_loaded(&y_value) != 0) {
+			tfm_tflm_stream_abort(session);
+			return PSA_ERROR_GENERIC_ERROR;
+		}
+	}
+
+	status = tfm_tflm_infer_encode(idx,
+				       NULL,
+				       session->cfg.enc_format,
+				       session->cfg.out_format,
+				       inf_val_encoded_buf,
+				       msg->out_size[0],
+				       &inf_val_encoded_buf_len);
+	if (status != PSA_SUCCESS) {
+		log_err_print("failed with %d", status);
+		tfm_tflm_stream_abort(session);
+		return status;
+	}
+
+	psa_write(msg->handle,
+		  0,
+		  inf_val_encoded_buf,
+		  inf_val_encoded_buf_len);
+	psa_write(msg->handle,
+		  1,
+		  &inf_val_encoded_buf_len,
+		  sizeof(inf_val_encoded_buf_len));
+
+	return PSA_SUCCESS;
+}
+
+/**
+ * \brief Streaming inference session.
+ *
+ * invec 0 carries a tflm_stream_req_t. Opening a stream resets the model's
+ * variable tensors, pushes then feed it one or more input frames in invec 1,
+ * keeping the state built up by earlier pushes. The stream belongs to the
+ * client's connection, so clients that keep their connection open can stream
+ * concurrently.
+ */
+psa_status_t tfm_tflm_stream(psa_msg_t *msg)
+{
+	psa_status_t status = PSA_SUCCESS;
+	tflm_session_t *session = msg->rhandle;
+	tflm_stream_req_t req;
+
+	/* Check size of invec parameter */
+	if (msg->in_size[0] != sizeof(req)) {
+		status = PSA_ERROR_PROGRAMMER_ERROR;
+		goto err;
+	}
+
+	psa_read(msg->handle, 0, &req, sizeof(req));
+	req.cfg.model[sizeof(req.cfg.model) - 1] = '\0';
+
+	switch (req.op) {
+	case TFLM_STREAM_OPEN:
+		status = tfm_tflm_stream_open(session, &req.cfg);
+		break;
+	case TFLM_STREAM_PUSH:
+		status = tfm_tflm_stream_push(session, msg);
+		break;
+	case TFLM_STREAM_CLOSE:
+		tfm_tflm_stream_close(session);
+		break;
+	default:
+		status = PSA_ERROR_PROGRAMMER_ERROR;
+		break;
+	}
+err:
+	return status;
+}
+
+/**
+ * \brief Initialise a model ahead of time, so that the first inference
+ * request for it does not pay the interpreter setup cost.
+ */
+psa_status_t tfm_tflm_model_warmup(psa_msg_t *msg)
+{
+	psa_status_t status = PSA_SUCCESS;
+	char model[TFLM_MODEL_BUFF_SIZE] = { 0 };
+	tflm_model_idx_t idx;
+
+	/* Check size of invec parameter */
+	if (msg->in_size[0] >= sizeof(model)) {
+		status = PSA_ERROR_PROGRAMMER_ERROR;
+		goto err;
+	}
+
+	psa_read(msg->handle, 0, model, msg->in_size[0]);
+	status = tfm_tflm_model_find(model, &idx);
+	if (status != PSA_SUCCESS) {
+		log_err_print("%s model is not supported", model);
+		goto err;
+	}
+
+	status = tfm_tflm_model_acquire(idx);
+err:
+	return status;
+}
+
 psa_status_t tfm_tflm_model_version(psa_msg_t *msg)
 {
 	psa_status_t status = PSA_SUCCESS;
 	char model[42] = { 0 };
-	_Bool is_model_supported = false;
-	int ctx_index = 0;
+	tflm_model_idx_t idx;
 
 	/* Check size of invec/outvec parameter */
 	if (msg->in_size[0] > sizeof(model) ||
@@ -295,24 +1174,16 @@ psa_status_t tfm_tflm_model_version(psa_msg_t *msg)
 	}
 
 	psa_read(msg->handle, 0, model, msg->in_size[0]);
-	for (int i = 0; i < TFLM_MODEL_COUNT; i++) {
-		if (strcmp(tflm_model_version[i].tflm_model, model) == 0) {
-			is_model_supported = true;
-			ctx_index = i;
-			break;
-		}
-	}
-
-	if (!is_model_supported) {
+	status = tfm_tflm_model_find(model, &idx);
+	if (status != PSA_SUCCESS) {
 		log_err_print("%s model is not supported", model);
-		status = PSA_ERROR_NOT_SUPPORTED;
 		goto err;
 	}
 
 	psa_write(msg->handle,
 		  0,
-		  tflm_model_version[ctx_index].tflm_model_version,
-		  strlen(tflm_model_version[ctx_index].tflm_model_version));
+		  tflm_model_version[idx].tflm_model_version,
+		  strlen(tflm_model_version[idx].tflm_model_version));
 err:
 	return status;
 }
@@ -339,20 +1210,35 @@ void tfm_tflm_signal_handle(psa_signal_t signal, signal_handler_t pfn)
 {
 	psa_status_t status;
 	psa_msg_t msg;
+	tflm_session_t *session;
 
 	status = psa_get(signal, &msg);
 	/* Decode the message */
 	switch (msg.type) {
-	/* Any setup or teardown on IPC connect or disconnect goes here. If
-	 * nothing then just reply with success.
+	/* Every connection to a stateful service gets its own session, which
+	 * lives until the client closes the connection.
 	 */
 	case PSA_IPC_CONNECT:
+		if (!(signal & TFLM_SESSION_SIGNALS)) {
+			psa_reply(msg.handle, PSA_SUCCESS);
+			break;
+		}
+		session = tfm_tflm_session_alloc();
+		if (session == NULL) {
+			psa_reply(msg.handle, PSA_ERROR_CONNECTION_BUSY);
+			break;
+		}
+		psa_set_rhandle(msg.handle, session);
+		psa_reply(msg.handle, PSA_SUCCESS);
+		break;
 	case PSA_IPC_DISCONNECT:
+		tfm_tflm_session_free(msg.rhandle);
 		psa_reply(msg.handle, PSA_SUCCESS);
 		break;
 
 	case PSA_IPC_CALL:
 		status = pfn(&msg);
+		sp_workspace_release(SP_WORKSPACE_OWNER_TFLM);
 		psa_reply(msg.handle, status);
 		break;
 	default:
@@ -403,8 +1289,10 @@ void tfm_tflm_service_req_mngr_init(void)
 
 	// LOG_INFFMT("[Example partition] Initialisation of I2C bus completed\r\n");
 
-	/* Tensorflow lite-micro initialisation */
-	setup();
+	/* Models are initialised lazily on their first request, only the
+	 * arena pool is set up here.
+	 */
+	tfm_tflm_arena_pool_init();
 
 	log_info_print("TFLM initalisation completed");
 
@@ -430,6 +1318,18 @@ void tfm_tflm_service_req_mngr_init(void)
 			tfm_tflm_signal_handle(
 				TFM_TFLM_VERSION_INFO_SERVICE_SIGNAL,
 				tfm_tflm_version_info);
+		} else if (signals & TFM_TFLM_MODEL_WARMUP_SERVICE_SIGNAL) {
+			tfm_tflm_signal_handle(
+				TFM_TFLM_MODEL_WARMUP_SERVICE_SIGNAL,
+				tfm_tflm_model_warmup);
+		} else if (signals & TFM_TFLM_INPUT_UPLOAD_SERVICE_SIGNAL) {
+			tfm_tflm_signal_handle(
+				TFM_TFLM_INPUT_UPLOAD_SERVICE_SIGNAL,
+				tfm_tflm_input_upload);
+		} else if (signals & TFM_TFLM_STREAM_SERVICE_SIGNAL) {
+			tfm_tflm_signal_handle(
+				TFM_TFLM_STREAM_SERVICE_SIGNAL,
+				tfm_tflm_stream);
 		} else {
 			psa_panic();
 		}
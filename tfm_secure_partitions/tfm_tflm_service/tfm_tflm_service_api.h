@@ -17,6 +17,20 @@
 #define TFLM_VERSION_BUFF_SIZE 42
 #define TFLM_MODEL_BUFF_SIZE 32
 
+/* Number of input staging slots and the largest input tensor, in elements,
+ * that can be uploaded into one of them.
+ */
+#define TFLM_INPUT_SLOTS 2
+#define TFLM_INPUT_SLOT_SIZE 256
+/* Float values read from the client per psa_read() during an upload. */
+#define TFLM_INPUT_READ_BLOCK 16
+
+/* Number of concurrent client connections, and the variable tensor bytes each
+ * of them can keep for an open stream.
+ */
+#define TFLM_SESSION_MAX 4
+#define TFLM_SESSION_STATE_SIZE 256
+
 /**
  * \brief Get the TFLM version
  *
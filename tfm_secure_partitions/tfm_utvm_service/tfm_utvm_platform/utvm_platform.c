@@ -6,14 +6,19 @@
 
 #include "utvm_platform.h"
 #include "tfm_sp_log.h"
+#include "sp_workspace.h"
 
 #define SERV_NAME "UTVM SERVICE"
 
-/* Memory pool for stack memory manager */
-static uint8_t g_aot_memory[WORKSPACE_SIZE];
+#if WORKSPACE_SIZE > SP_WORKSPACE_SIZE
+#error "SP_WORKSPACE_SIZE is too small for the UTVM workspace"
+#endif
 
 tvm_workspace_t app_workspace;
 
+/* Value of app_workspace.next_alloc to rewind to before each inference. */
+static uint8_t *utvm_rewind_mark;
+
 void TVMPlatformAbort(tvm_crt_error_t error)
 {
 	log_err_print("failed with %08x", error);
@@ -65,13 +70,89 @@ int TVMBackendFreeWorkspace(int device_type, int device_id, void *ptr)
 	return err;
 }
 
-void utvm_stack_mgr_init()
+/* Workspace size the stack manager was last set up with. */
+static size_t utvm_workspace_size;
+
+/* Shared workspace generation the stack manager was last set up at. */
+static uint32_t utvm_workspace_generation;
+
+static psa_status_t utvm_stack_mgr_setup(uint8_t *aot_memory,
+					 size_t workspace_size,
+					 uint32_t generation)
 {
-	tvm_crt_error_t err = StackMemoryManager_Init(&app_workspace, g_aot_memory, WORKSPACE_SIZE);
+	tvm_crt_error_t err;
 
+	err = StackMemoryManager_Init(&app_workspace, aot_memory, workspace_size);
 	if (err != kTvmErrorNoError) {
 		log_err_print("failed with %08x", err);
+		return PSA_ERROR_GENERIC_ERROR;
+	}
+	utvm_rewind_mark = app_workspace.next_alloc;
+	utvm_workspace_size = workspace_size;
+	utvm_workspace_generation = generation;
+
+	return PSA_SUCCESS;
+}
+
+psa_status_t utvm_stack_mgr_init()
+{
+	psa_status_t status;
+	uint8_t *aot_memory;
+	uint32_t generation;
+
+	/* The stack memory manager backing store lives in the secure workspace
+	 * shared with the TFLM partition. It is set up here to catch an
+	 * undersized pool at start, and set up again by utvm_stack_mgr_reset()
+	 * whenever TFLM used the pool in between.
+	 */
+	status = sp_workspace_acquire(SP_WORKSPACE_OWNER_UTVM,
+				      WORKSPACE_SIZE,
+				      &aot_memory,
+				      &generation);
+	if (status != PSA_SUCCESS) {
+		log_err_print("failed with %d", status);
+		return status;
+	}
+
+	status = utvm_stack_mgr_setup(aot_memory, WORKSPACE_SIZE, generation);
+	sp_workspace_release(SP_WORKSPACE_OWNER_UTVM);
+
+	return status;
+}
+
+psa_status_t utvm_stack_mgr_reset(size_t workspace_size)
+{
+	psa_status_t status;
+	uint8_t *aot_memory;
+	uint32_t generation;
+
+	status = sp_workspace_acquire(SP_WORKSPACE_OWNER_UTVM,
+				      workspace_size,
+				      &aot_memory,
+				      &generation);
+	if (status != PSA_SUCCESS) {
+		log_err_print("failed with %d", status);
+		return status;
+	}
+
+	/* Sizing the stack manager to the model keeps a model from running
+	 * past the workspace it was compiled for.
+	 */
+	if (generation != utvm_workspace_generation ||
+	    workspace_size != utvm_workspace_size) {
+		return utvm_stack_mgr_setup(aot_memory, workspace_size,
+					    generation);
 	}
+
+	/* Drop whatever the previous inference left on the stack. */
+	app_workspace.next_alloc = utvm_rewind_mark;
+
+	return PSA_SUCCESS;
+}
+
+void utvm_stack_mgr_release(void)
+{
+	sp_workspace_release(SP_WORKSPACE_OWNER_UTVM);
 }
 
 #if 0 // TODO
@@ -12,14 +12,36 @@
 #include <string.h>
 
 #include "../../tfm_huk_deriv_srv/tfm_huk_deriv_srv_api.h"
-#include "tvmgen_default.h"
+#include "utvm_models.h"
 
-/* Memory footprint for running the inference model */
-#define WORKSPACE_SIZE TVMGEN_DEFAULT_WORKSPACE_SIZE
+/* Memory footprint for running the largest inference model */
+#define WORKSPACE_SIZE UTVM_MODELS_MAX_WORKSPACE_SIZE
 
 /**
- * \brief Initialize the stack manager
+ * \brief Initialize the stack manager on the shared secure workspace. Called
+ *        once at partition start.
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t utvm_stack_mgr_init();
+
+/**
+ * \brief Rewind the stack manager before running an inference. The shared
+ *        workspace is held until utvm_stack_mgr_release() is called. If the
+ *        workspace was used by another engine in the meantime, or the model
+ *        needs a different workspace size, the stack manager is initialized
+ *        again instead.
+ *
+ * \param[in]   workspace_size  AOT workspace size of the model to run
+ *
+ * \return Returns error code as specified in \ref psa_status_t
+ */
+psa_status_t utvm_stack_mgr_reset(size_t workspace_size);
+
+/**
+ * \brief Let the other engines use the shared secure workspace again. Called
+ *        at the end of every request.
  */
-void utvm_stack_mgr_init();
+void utvm_stack_mgr_release(void);
 
 #endif // __TFM_UTVM_PLATFORM__
@@ -19,38 +19,104 @@
 	defined(CONFIG_SOC_MPS3_AN547)
 #include "platform_regs.h"
 #endif
-#include "tvmgen_default.h"
+#include "utvm_models.h"
 #include "utvm_platform.h"
 
 #define SERV_NAME "UTVM SERVICE"
 
 typedef psa_status_t (*signal_handler_t)(psa_msg_t *);
 
-/* The model index is key to finding the utvm model from the utvm_models array
- * and this gets validated in the utvm secure service to select the model to
- * run the inference engine.
- */
-typedef enum {
-	UTVM_MODEL_SINE = 0,                    /**< Sine inference model index*/
-	UTVM_MODEL_COUNT,                       /**< Number of models present */
-} utvm_model_idx_t;
-
-typedef struct {
-	char utvm_model[UTVM_MODEL_BUFF_SIZE];                  /* List of supported utvm models */
-	char utvm_model_version[UTVM_VERSION_BUFF_SIZE];        /* md5sum tflite model calculated value */
-} utvm_model_version_t;
-
 typedef struct {
 	huk_enc_format_t enc_format;
 	char model[32];
+	huk_out_format_t out_format;
 } utvm_config_t;
 
+/* Per-client state, allocated on PSA_IPC_CONNECT to the inference service
+ * and bound to the connection's rhandle, caching the last validated
+ * inference config. The version services are stateless and take no session.
+ */
+typedef struct {
+	_Bool in_use;
+	_Bool has_config;               /* cfg and model were validated */
+	utvm_config_t cfg;
+	const utvm_model_t *model;
+} utvm_session_t;
+
+static utvm_session_t utvm_session[UTVM_SESSION_MAX];
+
 /* Get the MicroTVM version using `tvmc --version` command */
 static const char utvm_version[UTVM_VERSION_BUFF_SIZE] = "0.9.dev0";
 
-/* Sine model version is created using `md5sum /path/to/sine_model.tflite` */
-static const utvm_model_version_t utvm_model_version[UTVM_MODEL_COUNT] =
-{ { "UTVM_MODEL_SINE", "b8085238f6e790f25de393e203136776" } };
+/* The supported models, their AOT entry points and versions come from the
+ * utvm_models table generated from the MLF packages at build time. Model
+ * versions are created using `md5sum /path/to/model.tflite`.
+ */
+static const utvm_model_t *utvm_model_find(const char *model)
+{
+	for (int i = 0; i < UTVM_MODEL_COUNT; i++) {
+		if (strcmp(utvm_models[i].model, model) == 0) {
+			return &utvm_models[i];
+		}
+	}
+
+	return NULL;
+}
+
+static utvm_session_t *tfm_utvm_session_alloc(void)
+{
+	for (int i = 0; i < UTVM_SESSION_MAX; i++) {
+		if (!utvm_session[i].in_use) {
+			memset(&utvm_session[i], 0, sizeof(utvm_session[i]));
+			utvm_session[i].in_use = true;
+			return &utvm_session[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * \brief Validate an inference config and select its model, unless it is the
+ * config the session validated last.
+ */
+static psa_status_t tfm_utvm_session_config(utvm_session_t *session,
+					    const utvm_config_t *cfg)
+{
+	const utvm_model_t *model;
+
+	if (session->has_config &&
+	    memcmp(&session->cfg, cfg, sizeof(*cfg)) == 0) {
+		return PSA_SUCCESS;
+	}
+
+	model = utvm_model_find(cfg->model);
+	if (model == NULL) {
+		log_err_print("%s model is not supported", cfg->model);
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	/* The AOT models dequantize in the graph, so only float output is
+	 * available here.
+	 */
+	if (cfg->out_format != HUK_OUT_FLOAT) {
+		log_err_print("%s output format is not supported", cfg->model);
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	/* The encoder signs a single float inference value */
+	if (model->input_size != sizeof(float) ||
+	    model->output_size != sizeof(float)) {
+		log_err_print("%s tensor sizes are not supported", cfg->model);
+		return PSA_ERROR_NOT_SUPPORTED;
+	}
+
+	memcpy(&session->cfg, cfg, sizeof(*cfg));
+	session->model = model;
+	session->has_config = true;
+
+	return PSA_SUCCESS;
+}
 
 /**
  * \brief Run inference using UTVM
@@ -58,10 +124,11 @@ static const utvm_model_version_t utvm_model_version[UTVM_MODEL_COUNT] =
 psa_status_t tfm_utvm_infer_run(psa_msg_t *msg)
 {
 	psa_status_t status = PSA_SUCCESS;
+	utvm_session_t *session = msg->rhandle;
 	float model_in_val, model_out_val;
 	uint8_t inf_val_encoded_buf[msg->out_size[0]];
-	_Bool is_model_supported = false;
 	size_t inf_val_encoded_buf_len = 0;
+	const utvm_model_t *model;
 	utvm_config_t cfg;
 
 	/* Check size of invec/outvec parameter */
@@ -70,33 +137,30 @@ psa_status_t tfm_utvm_infer_run(psa_msg_t *msg)
 		goto err;
 	}
 
-	utvm_stack_mgr_init();
-	psa_read(msg->handle, 0, &model_in_val, msg->in_size[0]);
 	psa_read(msg->handle, 1, &cfg, sizeof(utvm_config_t));
+	cfg.model[sizeof(cfg.model) - 1] = '\0';
 
-	for (int i = 0; i < UTVM_MODEL_COUNT; i++) {
-		if (strcmp(utvm_model_version[i].utvm_model, cfg.model) == 0) {
-			is_model_supported = true;
-			break;
-		}
+	status = tfm_utvm_session_config(session, &cfg);
+	if (status != PSA_SUCCESS) {
+		goto err;
 	}
+	model = session->model;
 
-	if (!is_model_supported) {
-		log_err_print("%s model is not supported", cfg.model);
-		status = PSA_ERROR_NOT_SUPPORTED;
+	if (msg->in_size[0] != model->input_size) {
+		status = PSA_ERROR_PROGRAMMER_ERROR;
 		goto err;
 	}
 
-	struct tvmgen_default_inputs inputs = {
-		.dense_4_input = (void *)&model_in_val,
-	};
-	struct tvmgen_default_outputs outputs = {
-		.Identity = (void *)&model_out_val,
-	};
+	psa_read(msg->handle, 0, &model_in_val, msg->in_size[0]);
+
+	status = utvm_stack_mgr_reset(model->workspace_size);
+	if (status != PSA_SUCCESS) {
+		goto err;
+	}
 
 	/* Run inference */
 	log_info_print("Starting secure inferencing");
-	status = tvmgen_default_run(&inputs, &outputs);
+	status = model->run(&model_in_val, &model_out_val);
 	if (status != 0) {
 		log_err_print("failed with %d", status);
 		goto err;
@@ -130,26 +194,18 @@ psa_status_t tfm_utvm_model_version(psa_msg_t *msg)
 {
 	psa_status_t status = PSA_SUCCESS;
 	char model[42] = { 0 };
-	_Bool is_model_supported = false;
-	int ctx_index = 0;
+	const utvm_model_t *desc;
 
 	/* Check size of invec/outvec parameter */
-	if (msg->in_size[0] > sizeof(model) ||
+	if (msg->in_size[0] >= sizeof(model) ||
 	    msg->out_size[0] != UTVM_VERSION_BUFF_SIZE) {
 		status = PSA_ERROR_PROGRAMMER_ERROR;
 		goto err;
 	}
 
 	psa_read(msg->handle, 0, model, msg->in_size[0]);
-	for (int i = 0; i < UTVM_MODEL_COUNT; i++) {
-		if (strcmp(utvm_model_version[i].utvm_model, model) == 0) {
-			is_model_supported = true;
-			ctx_index = i;
-			break;
-		}
-	}
-
-	if (!is_model_supported) {
+	desc = utvm_model_find(model);
+	if (desc == NULL) {
 		log_err_print("%s model is not supported", model);
 		status = PSA_ERROR_NOT_SUPPORTED;
 		goto err;
@@ -157,8 +213,8 @@ psa_status_t tfm_utvm_model_version(psa_msg_t *msg)
 
 	psa_write(msg->handle,
 		  0,
-		  utvm_model_version[ctx_index].utvm_model_version,
-		  strlen(utvm_model_version[ctx_index].utvm_model_version));
+		  desc->version,
+		  strlen(desc->version));
 
 err:
 	return status;
@@ -186,20 +242,38 @@ void tfm_utvm_signal_handle(psa_signal_t signal, signal_handler_t pfn)
 {
 	psa_status_t status;
 	psa_msg_t msg;
+	utvm_session_t *session;
 
 	status = psa_get(signal, &msg);
 	/* Decode the message */
 	switch (msg.type) {
-	/* Any setup or teardown on IPC connect or disconnect goes here. If
-	 * nothing then just reply with success.
+	/* Every connection to the inference service gets its own session,
+	 * which lives until the client closes the connection.
 	 */
 	case PSA_IPC_CONNECT:
+		if (signal != TFM_UTVM_SINE_MODEL_SERVICE_SIGNAL) {
+			psa_reply(msg.handle, PSA_SUCCESS);
+			break;
+		}
+		session = tfm_utvm_session_alloc();
+		if (session == NULL) {
+			psa_reply(msg.handle, PSA_ERROR_CONNECTION_BUSY);
+			break;
+		}
+		psa_set_rhandle(msg.handle, session);
+		psa_reply(msg.handle, PSA_SUCCESS);
+		break;
 	case PSA_IPC_DISCONNECT:
+		session = msg.rhandle;
+		if (session != NULL) {
+			session->in_use = false;
+		}
 		psa_reply(msg.handle, PSA_SUCCESS);
 		break;
 
 	case PSA_IPC_CALL:
 		status = pfn(&msg);
+		utvm_stack_mgr_release();
 		psa_reply(msg.handle, status);
 		break;
 	default:
@@ -214,6 +288,10 @@ void tfm_utvm_service_req_mngr_init(void)
 {
 	psa_signal_t signals;
 
+	if (utvm_stack_mgr_init() != PSA_SUCCESS) {
+		psa_panic();
+	}
+
 	log_info_print("UTVM initalisation completed");
 
 	/* Continually wait for one or more of the partition's RoT Service or
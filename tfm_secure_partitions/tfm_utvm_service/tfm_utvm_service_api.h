@@ -17,6 +17,9 @@
 #define UTVM_VERSION_BUFF_SIZE 42
 #define UTVM_MODEL_BUFF_SIZE   32
 
+/* Number of concurrent client connections */
+#define UTVM_SESSION_MAX       4
+
 /**
  * \brief Get the MicroTVM version
  *
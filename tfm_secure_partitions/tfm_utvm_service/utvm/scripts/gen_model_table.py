@@ -0,0 +1,187 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2022 Linaro Limited
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Generate the UTVM model dispatch table.
+
+Every model built into the UTVM service is a Model Library Format (MLF)
+package compiled with its own module name (`tvmc compile --module-name`), so
+it exposes a `tvmgen_<name>_run()` entry point. This script reads each
+package's metadata.json, generated header and relay source, and emits a table
+mapping model IDs to a uniform run function, the input/output tensor sizes and
+the AOT workspace size of the model.
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+DTYPE_SIZE = {
+    "float32": 4, "float16": 2, "int32": 4, "uint32": 4,
+    "int16": 2, "uint16": 2, "int8": 1, "uint8": 1,
+}
+
+
+def fail(msg):
+    sys.exit("error: %s" % msg)
+
+
+def struct_fields(header, module, kind):
+    """Return the tensor names of the tvmgen_<module>_<kind> struct."""
+    match = re.search(r"struct tvmgen_%s_%s\s*\{([^}]*)\}" % (module, kind), header)
+    if match is None:
+        fail("struct tvmgen_%s_%s not found" % (module, kind))
+    return re.findall(r"void\*\s*(\w+);", match.group(1))
+
+
+def tensor_bytes(relay, name):
+    """Return the size in bytes of the named main() parameter."""
+    match = re.search(r"%%%s: Tensor\[\(([^)]*)\), (\w+)\]" % re.escape(name), relay)
+    if match is None:
+        fail("input %s not found in relay source" % name)
+    count = 1
+    for dim in match.group(1).split(","):
+        if dim.strip():
+            count *= int(dim)
+    if match.group(2) not in DTYPE_SIZE:
+        fail("unsupported dtype %s" % match.group(2))
+    return count * DTYPE_SIZE[match.group(2)]
+
+
+def load_model(label, path, version):
+    with open(os.path.join(path, "metadata.json")) as f:
+        metadata = json.load(f)
+
+    module = metadata["model_name"]
+    main = metadata["memory"]["functions"]["main"][0]
+
+    with open(os.path.join(path, "codegen", "host", "include",
+                           "tvmgen_%s.h" % module)) as f:
+        header = f.read()
+    with open(os.path.join(path, "src", "relay.txt")) as f:
+        relay = f.read()
+
+    inputs = struct_fields(header, module, "inputs")
+    outputs = struct_fields(header, module, "outputs")
+    if len(inputs) != 1 or len(outputs) != 1:
+        fail("%s: only single input/output models are supported" % label)
+
+    input_size = tensor_bytes(relay, inputs[0])
+
+    return {
+        "id": "UTVM_MODEL_%s" % label.upper(),
+        "module": module,
+        "version": version,
+        "input": inputs[0],
+        "output": outputs[0],
+        "input_size": input_size,
+        "output_size": main["io_size_bytes"] - input_size,
+        "workspace_size": main["workspace_size_bytes"],
+    }
+
+
+HEADER = """\
+/*
+ * Generated by gen_model_table.py, do not edit.
+ */
+
+#ifndef __UTVM_MODELS_H__
+#define __UTVM_MODELS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Number of models built into the UTVM service */
+#define UTVM_MODEL_COUNT %(count)d
+
+/* Largest AOT workspace needed by any of the models */
+#define UTVM_MODELS_MAX_WORKSPACE_SIZE %(max_workspace)d
+
+typedef int32_t (*utvm_model_run_t)(void *input, void *output);
+
+typedef struct {
+	const char *model;              /* Model ID, e.g. UTVM_MODEL_SINE */
+	const char *version;            /* md5sum of the source model */
+	utvm_model_run_t run;           /* AOT entry point */
+	size_t input_size;              /* Input tensor size in bytes */
+	size_t output_size;             /* Output tensor size in bytes */
+	size_t workspace_size;          /* AOT workspace size in bytes */
+} utvm_model_t;
+
+extern const utvm_model_t utvm_models[UTVM_MODEL_COUNT];
+
+#endif /* __UTVM_MODELS_H__ */
+"""
+
+
+def emit_header(out, models):
+    out.write(HEADER % {
+        "count": len(models),
+        "max_workspace": max(m["workspace_size"] for m in models),
+    })
+
+
+def emit_source(out, models):
+    out.write("/*\n * Generated by gen_model_table.py, do not edit.\n */\n\n")
+    out.write("#include \"utvm_models.h\"\n")
+    for m in models:
+        out.write("#include \"tvmgen_%s.h\"\n" % m["module"])
+
+    for m in models:
+        out.write("""
+static int32_t utvm_%(module)s_run(void *input, void *output)
+{
+	struct tvmgen_%(module)s_inputs inputs = {
+		.%(input)s = input,
+	};
+	struct tvmgen_%(module)s_outputs outputs = {
+		.%(output)s = output,
+	};
+
+	return tvmgen_%(module)s_run(&inputs, &outputs);
+}
+""" % m)
+
+    out.write("\nconst utvm_model_t utvm_models[UTVM_MODEL_COUNT] = {\n")
+    for m in models:
+        out.write("\t{ \"%(id)s\", \"%(version)s\", utvm_%(module)s_run,\n"
+                  "\t  %(input_size)d, %(output_size)d, %(workspace_size)d },\n" % m)
+    out.write("};\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--model", action="append", required=True,
+                        metavar="LABEL:PATH:VERSION",
+                        help="MLF package to add to the table")
+    parser.add_argument("--output-dir", required=True)
+    args = parser.parse_args()
+
+    models = []
+    for spec in args.model:
+        # The path may itself contain ':', the label and version may not.
+        try:
+            label, rest = spec.split(":", 1)
+            path, version = rest.rsplit(":", 1)
+        except ValueError:
+            label = path = version = None
+        if not label or not path or not version:
+            fail("invalid model spec '%s', expected LABEL:PATH:VERSION" % spec)
+        models.append(load_model(label, path, version))
+
+    modules = [m["module"] for m in models]
+    if len(set(modules)) != len(modules):
+        fail("MLF packages must be compiled with distinct module names")
+
+    with open(os.path.join(args.output_dir, "utvm_models.h"), "w") as out:
+        emit_header(out, models)
+    with open(os.path.join(args.output_dir, "utvm_models.c"), "w") as out:
+        emit_source(out, models)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,314 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2022 Linaro Limited
+#
+# SPDX-License-Identifier: Apache-2.0
+
+"""Pre-pack microTVM dense weights at build time.
+
+The dense schedules generated by TVM allocate a workspace buffer at the start
+of every call and repack a weight constant into it, e.g. from [N, K] into
+[N / bn, K, bn]. The repack only depends on the constant, so this script runs
+it once at build time instead.
+
+The MLF package is left untouched. A copy of it is written to the output
+directory, in which:
+
+- every repack loop nest found in the generated sources is evaluated, and its
+  result is emitted as a packed constant in flash;
+- the workspace allocation, the repack loop and the matching free are replaced
+  by a pointer to the packed constant;
+- the workspace sizes of metadata.json and of the generated header are reduced
+  by the allocations that were removed.
+
+Loop nests that are not a plain copy from a constant into the workspace buffer
+are left as generated.
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import sys
+
+# TVMBackendAllocWorkspace(device_type, device_id, nbytes, dtype_code_hint,
+# dtype_bits_hint) of a float32 buffer, followed by its NULL check.
+ALLOC_RE = re.compile(
+    r"^(?P<indent>[ \t]*)void\* (?P<var>\w+) = TVMBackendAllocWorkspace\("
+    r"1, 0, \(uint64_t\)(?P<nbytes>\d+), 2, 32\);\n"
+    r"[ \t]*if \((?P=var) == NULL\) \{\n"
+    r"[ \t]*return -1;\n"
+    r"[ \t]*\}\n", re.M)
+
+FREE_RE = r"^[ \t]*if \(TVMBackendFreeWorkspace\(1, 0, %s\) != 0\) \{\n" \
+          r"[ \t]*return -1;\n" \
+          r"[ \t]*\}\n"
+
+FOR_RE = re.compile(r"for \(int32_t (\w+) = 0; \1 < (\d+); \+\+\1\) \{$")
+LET_RE = re.compile(r"int32_t (\w+) = (.+);$")
+COPY_RE = re.compile(r"\(\(float\*\)(\w+)\)\[(.+)\] = \(\(float\*\)(\w+)\)\[(.+)\];$")
+EXPR_RE = re.compile(r"^[\w\s+*()]+$")
+
+FUNC_RE = re.compile(r"^TVM_DLL int32_t (\w+)\(", re.M)
+
+
+def fail(msg):
+    sys.exit("error: %s" % msg)
+
+
+def read_constant(src, name):
+    """Return the float values of the named constant array, None if absent."""
+    pattern = r"\b%s\[(\d+)\]\s*=\s*\{([^}]*)\}" % re.escape(name)
+    match = re.search(pattern, src)
+    if match is None:
+        return None
+
+    values = [float.fromhex(v) for v in match.group(2).replace("\n", " ").split(",")
+              if v.strip()]
+    if len(values) != int(match.group(1)):
+        fail("%s has %d values, expected %s" %
+             (name, len(values), match.group(1)))
+    return values
+
+
+def parse_nest(lines, pos):
+    """Parse a loop nest made of for loops, int32_t temporaries and a single
+    float copy. Return the nest and the index of the line after it, or None
+    if the code does anything else."""
+    match = FOR_RE.match(lines[pos].strip())
+    if match is None:
+        return None
+    loop = {"var": match.group(1), "count": int(match.group(2)), "body": []}
+    pos += 1
+    while pos < len(lines):
+        line = lines[pos].strip()
+        if line == "}":
+            return loop, pos + 1
+        if FOR_RE.match(line):
+            inner = parse_nest(lines, pos)
+            if inner is None:
+                return None
+            loop["body"].append(("for", inner[0]))
+            pos = inner[1]
+            continue
+        let = LET_RE.match(line)
+        copy = COPY_RE.match(line)
+        if let and EXPR_RE.match(let.group(2)):
+            loop["body"].append(("let", let.group(1), let.group(2)))
+        elif copy and EXPR_RE.match(copy.group(2)) and EXPR_RE.match(copy.group(4)):
+            loop["body"].append(("copy",) + copy.groups())
+        else:
+            return None
+        pos += 1
+    return None
+
+
+def copies(loop):
+    """Return the (dst buffer, src constant) pairs copied by the nest."""
+    found = set()
+    for stmt in loop["body"]:
+        if stmt[0] == "for":
+            found |= copies(stmt[1])
+        elif stmt[0] == "copy":
+            found.add((stmt[1], stmt[3]))
+    return found
+
+
+def run_nest(loop, env, dst, src):
+    for i in range(loop["count"]):
+        scope = dict(env)
+        scope[loop["var"]] = i
+        for stmt in loop["body"]:
+            if stmt[0] == "for":
+                run_nest(stmt[1], scope, dst, src)
+            elif stmt[0] == "let":
+                scope[stmt[1]] = eval(stmt[2], {"__builtins__": {}}, scope)
+            else:
+                d = eval(stmt[2], {"__builtins__": {}}, scope)
+                s = eval(stmt[4], {"__builtins__": {}}, scope)
+                dst[d] = src[s]
+
+
+def c_float(value):
+    """Exact hex float literal, without the trailing zeros of float.hex()."""
+    return re.sub(r"0+p", "p", value.hex())
+
+
+def emit_constant(symbol, values):
+    out = ["static const float __attribute__((section(\".rodata.tvm\"), "
+           "aligned(16))) %s[%d] = {\n" % (symbol, len(values))]
+    for i in range(0, len(values), 8):
+        out.append("    %s,\n" % ", ".join(c_float(v) for v in values[i:i + 8]))
+    out.append("};\n")
+    return "".join(out)
+
+
+def prepack_function(src, start, end, module, constants):
+    """Pre-pack the repack loops of the function at src[start:end]. Return
+    the new function text, the packed constants to emit in front of it and
+    the workspace bytes saved."""
+    body = src[start:end]
+    tables = []
+    saved = 0
+
+    while True:
+        alloc = None
+        for match in ALLOC_RE.finditer(body):
+            rest = body[match.end():].split("\n")
+            nest = parse_nest(rest, 0)
+            if nest is None:
+                continue
+            pairs = copies(nest[0])
+            if len(pairs) != 1 or next(iter(pairs))[0] != match.group("var"):
+                continue
+            alloc = (match, nest, next(iter(pairs))[1])
+            break
+        if alloc is None:
+            return body, tables, saved
+
+        match, (loop, nlines), constant = alloc
+        var = match.group("var")
+        nbytes = int(match.group("nbytes"))
+        values = constants.get(constant)
+        if values is None:
+            fail("constant %s not found" % constant)
+
+        packed = [None] * (nbytes // 4)
+        try:
+            run_nest(loop, {}, packed, values)
+        except IndexError:
+            fail("repack of %s is out of bounds" % constant)
+        if None in packed:
+            fail("repack of %s does not fill the %d byte buffer" %
+                 (constant, nbytes))
+
+        symbol = "tvmgen_%s_%s_packed" % (module, constant)
+        tables.append(emit_constant(symbol, packed))
+
+        rest = body[match.end():].split("\n")
+        after = "\n".join(rest[nlines:])
+        after, nfree = re.subn(FREE_RE % re.escape(var), "", after,
+                               count=1, flags=re.M)
+        if nfree != 1:
+            fail("workspace %s is not freed" % var)
+
+        body = (body[:match.start()] +
+                "%sconst float* %s = %s;\n" % (match.group("indent"), var, symbol) +
+                after)
+        saved += nbytes
+
+
+def prepack_source(src, module, constants):
+    """Return the pre-packed source and the workspace bytes saved by each
+    operator function."""
+    saved = {}
+    out = []
+    pos = 0
+    funcs = list(FUNC_RE.finditer(src))
+    for i, func in enumerate(funcs):
+        end = funcs[i + 1].start() if i + 1 < len(funcs) else len(src)
+        body, tables, nbytes = prepack_function(src, func.start(), end,
+                                                module, constants)
+        if not tables:
+            continue
+        # The packed constants go in front of the function, ahead of its
+        # extern "C" guard.
+        head = src.rfind("#ifdef __cplusplus", pos, func.start())
+        if head < 0:
+            head = func.start()
+        out.append(src[pos:head])
+        out.extend(tables)
+        out.append(src[head:func.start()])
+        out.append(body)
+        pos = end
+        saved[func.group(1)] = nbytes
+    out.append(src[pos:])
+    return "".join(out), saved
+
+
+def update_metadata(metadata, saved):
+    """Reduce the workspace sizes by the allocations removed. The AOT main
+    function holds the intermediate tensors plus the workspace of the largest
+    operator, as the operators run one after another."""
+    functions = metadata["memory"]["functions"]
+    ops = functions["operator_functions"]
+
+    def largest():
+        return max([ws["workspace_size_bytes"]
+                    for op in ops for ws in op["workspace"]] + [0])
+
+    before = largest()
+    for op in ops:
+        nbytes = saved.get(op["function_name"], 0)
+        for ws in op["workspace"]:
+            if nbytes:
+                if ws["workspace_size_bytes"] < nbytes:
+                    fail("%s workspace is smaller than its allocations" %
+                         op["function_name"])
+                ws["workspace_size_bytes"] -= nbytes
+    after = largest()
+
+    for main in functions["main"]:
+        if main["workspace_size_bytes"] < before:
+            fail("main workspace is smaller than the largest operator")
+        main["workspace_size_bytes"] -= before - after
+    return functions["main"][0]["workspace_size_bytes"]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--package", required=True,
+                        help="MLF package directory, e.g. utvm/sine")
+    parser.add_argument("--output-dir", required=True,
+                        help="Directory to write the pre-packed package to")
+    args = parser.parse_args()
+
+    with open(os.path.join(args.package, "metadata.json")) as f:
+        metadata = json.load(f)
+    module = metadata["model_name"]
+
+    src_dir = os.path.join(args.package, "codegen", "host", "src")
+    inc_dir = os.path.join(args.package, "codegen", "host", "include")
+    sources = {}
+    for name in sorted(os.listdir(src_dir)):
+        with open(os.path.join(src_dir, name)) as f:
+            sources[name] = f.read()
+
+    constants = {}
+    for src in sources.values():
+        for name in re.findall(r"\b(constant_\d+)\[\d+\]\s*=", src):
+            constants[name] = read_constant(src, name)
+
+    saved = {}
+    for name in sources:
+        sources[name], nbytes = prepack_source(sources[name], module, constants)
+        saved.update(nbytes)
+
+    workspace = update_metadata(metadata, saved)
+
+    out_src = os.path.join(args.output_dir, "codegen", "host", "src")
+    out_inc = os.path.join(args.output_dir, "codegen", "host", "include")
+    out_relay = os.path.join(args.output_dir, "src")
+    for d in (out_src, out_inc, out_relay):
+        os.makedirs(d, exist_ok=True)
+
+    for name, src in sources.items():
+        with open(os.path.join(out_src, name), "w") as f:
+            f.write(src)
+
+    for name in os.listdir(inc_dir):
+        with open(os.path.join(inc_dir, name)) as f:
+            header = f.read()
+        header = re.sub(r"(#define TVMGEN_%s_WORKSPACE_SIZE )\d+" % module.upper(),
+                        r"\g<1>%d" % workspace, header)
+        with open(os.path.join(out_inc, name), "w") as f:
+            f.write(header)
+
+    with open(os.path.join(args.output_dir, "metadata.json"), "w") as f:
+        json.dump(metadata, f, indent=2, sort_keys=True)
+    shutil.copy(os.path.join(args.package, "src", "relay.txt"), out_relay)
+
+
+if __name__ == "__main__":
+    main()